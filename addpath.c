@@ -1,13 +1,33 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <sys/param.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef AF_LINK
+#include <net/if_dl.h>
+#endif
 
 extern const char *rtems_bsdnet_domain_name;
 
+#ifndef GESYS_RTEMS_BSP
+#define GESYS_RTEMS_BSP "unknown"
+#endif
+
 #ifndef DEBUG_MAIN
+extern struct in_addr rtems_bsdnet_bootp_server_address;
 #include <reent.h>
 extern void __env_lock(struct _reent *);
 extern void __env_unlock(struct _reent *);
@@ -16,6 +36,7 @@ extern void __env_unlock(struct _reent *);
 #define __env_unlock(x) do { } while (0)
 static char dombuf[100];
 const char *rtems_bsdnet_domain_name = dombuf;
+static struct in_addr rtems_bsdnet_bootp_server_address;
 #endif
 
 /* append/prepend to environment var */
@@ -115,6 +136,346 @@ cleanup:
 	return rval;
 }
 
+/* Template expansion
+ *
+ * A template is a string with '%<tagchar>' occurrences. Expansion
+ * runs in a single pass over the template, writing to a caller
+ * supplied buffer with snprintf() semantics (the full length is
+ * returned even if the buffer is too small).
+ *
+ * Templates which are expanded repeatedly may be 'compiled' once
+ * (pathTmplCompile()); the compiled form holds the literal runs
+ * and the tags so expansion is just a sequence of memcpy()s.
+ */
+
+/* user-supplied substitution (length computed on first use) */
+typedef struct SubstUserRec_ {
+	const char	*val;
+	int			len;
+} SubstUserRec, *SubstUser;
+
+/* number of user substitutions held in the context itself */
+#define SUBST_USER_INLINE	16
+
+typedef struct SubstCtxRec_ {
+	/* user-supplied substitutions ("<tagchar><subst>") compiled
+	 * into a table dispatched on the tag char: map[tag] is 1 +
+	 * the index into 'user' (0: no user substitution for 'tag').
+	 */
+	unsigned char		map[256];
+	SubstUser			user;
+	SubstUserRec		userBuf[SUBST_USER_INLINE];
+	/* builtin (pathSubstitute) tags */
+	int					builtin;
+	char				*cwd;
+} SubstCtxRec, *SubstCtx;
+
+typedef struct SubstSegRec_ {
+	const char	*lit;	/* literal run or NULL for a tag */
+	int			len;	/* length of literal run or tag char */
+} SubstSegRec, *SubstSeg;
+
+struct PathTmplRec_ {
+	int			nsegs;
+	SubstSegRec	segs[];
+	/* followed by a copy of the template */
+};
+
+typedef struct PathTmplRec_ *PathTmpl;
+
+#define MAX_NAM 100
+
+static char hostCache[MAX_NAM];
+static char domCache[MAX_NAM];
+static char ipCache[INET_ADDRSTRLEN];
+static char srvCache[INET_ADDRSTRLEN];
+static char macCache[3*6];
+static int  hostCacheLen = -1;
+static int  domCacheLen  = -1;
+static int  ipCacheLen   = -1;
+static int  srvCacheLen  = -1;
+static int  macCacheLen  = -1;
+static int  bspLen       = sizeof(GESYS_RTEMS_BSP) - 1;
+
+/* Find IP and MAC address of the first interface which is
+ * up and not the loopback interface.
+ */
+static void
+ifaddrRefresh()
+{
+char                buf[2048];
+struct ifconf       ifc;
+struct ifreq        *ifr, ifrq;
+char                *p, ifnam[IFNAMSIZ + 1];
+int                 sd, len;
+unsigned char       *mac = 0;
+struct sockaddr_in  *sin;
+
+	ipCache[0]  = 0;
+	macCache[0] = 0;
+	ifnam[0]    = 0;
+
+	if ( (sd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 )
+		return;
+
+	ifc.ifc_len = sizeof(buf);
+	ifc.ifc_buf = buf;
+	if ( ioctl(sd, SIOCGIFCONF, &ifc) < 0 )
+		goto bail;
+
+	/* BSD-style entries have variable length */
+	for ( p = buf; p < buf + ifc.ifc_len; p += len ) {
+		ifr = (struct ifreq*)p;
+#ifdef AF_LINK
+		len = IFNAMSIZ + ifr->ifr_addr.sa_len;
+		if ( len < sizeof(*ifr) )
+			len = sizeof(*ifr);
+#else
+		len = sizeof(*ifr);
+#endif
+		if ( AF_INET != ifr->ifr_addr.sa_family || ifnam[0] )
+			continue;
+		memcpy(ifrq.ifr_name, ifr->ifr_name, IFNAMSIZ);
+		if ( ioctl(sd, SIOCGIFFLAGS, &ifrq) < 0 )
+			continue;
+		if ( !(ifrq.ifr_flags & IFF_UP) || (ifrq.ifr_flags & IFF_LOOPBACK) )
+			continue;
+		sin = (struct sockaddr_in*)&ifr->ifr_addr;
+		inet_ntop(AF_INET, &sin->sin_addr, ipCache, sizeof(ipCache));
+		strncpy(ifnam, ifr->ifr_name, IFNAMSIZ);
+		ifnam[IFNAMSIZ] = 0;
+	}
+
+	if ( !ifnam[0] )
+		goto bail;
+
+#ifdef AF_LINK
+	for ( p = buf; p < buf + ifc.ifc_len; p += len ) {
+		ifr = (struct ifreq*)p;
+		len = IFNAMSIZ + ifr->ifr_addr.sa_len;
+		if ( len < sizeof(*ifr) )
+			len = sizeof(*ifr);
+		if ( AF_LINK == ifr->ifr_addr.sa_family && !strncmp(ifr->ifr_name, ifnam, IFNAMSIZ) ) {
+			struct sockaddr_dl *sdl = (struct sockaddr_dl*)&ifr->ifr_addr;
+			if ( 6 == sdl->sdl_alen )
+				mac = (unsigned char*)LLADDR(sdl);
+			break;
+		}
+	}
+#elif defined(SIOCGIFHWADDR)
+	memcpy(ifrq.ifr_name, ifnam, IFNAMSIZ);
+	if ( 0 == ioctl(sd, SIOCGIFHWADDR, &ifrq) )
+		mac = (unsigned char*)ifrq.ifr_hwaddr.sa_data;
+#endif
+
+	if ( mac )
+		sprintf(macCache, "%02x:%02x:%02x:%02x:%02x:%02x",
+			mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+bail:
+	close(sd);
+}
+
+/* (Re-)read the cached values of builtin substitutions; this
+ * is done once the network is up and should be repeated if
+ * e.g., the hostname is changed.
+ */
+void
+pathSubstituteRefresh()
+{
+	if ( gethostname(hostCache, sizeof(hostCache) - 1) )
+		hostCache[0] = 0;
+	hostCache[sizeof(hostCache) - 1] = 0;
+	hostCacheLen = strlen(hostCache);
+
+	if ( rtems_bsdnet_domain_name ) {
+		strncpy(domCache, rtems_bsdnet_domain_name, sizeof(domCache) - 1);
+		domCache[sizeof(domCache) - 1] = 0;
+	} else {
+		domCache[0] = 0;
+	}
+	domCacheLen = strlen(domCache);
+
+	if ( !rtems_bsdnet_bootp_server_address.s_addr
+	     || !inet_ntop(AF_INET, &rtems_bsdnet_bootp_server_address, srvCache, sizeof(srvCache)) )
+		srvCache[0] = 0;
+	srvCacheLen = strlen(srvCache);
+
+	ifaddrRefresh();
+	ipCacheLen  = strlen(ipCache);
+	macCacheLen = strlen(macCache);
+}
+
+/* Compile the 'ns' user substitutions 's' into the (zeroed)
+ * context; the first substitution for a tag char wins.
+ *
+ * RETURNS: 0 on success, -1 on error (no memory).
+ */
+static int
+substUserCompile(SubstCtx c, const char * const *s, int ns)
+{
+int           i, n;
+unsigned char tag;
+
+	c->user = c->userBuf;
+	if ( ns > SUBST_USER_INLINE && !(c->user = malloc(sizeof(*c->user) * ns)) )
+		return -1;
+	for ( i = n = 0; i < ns; i++ ) {
+		/* at most 255 distinct (non-NUL) tag chars */
+		if ( !(tag = *s[i]) || c->map[tag] )
+			continue;
+		c->user[n].val = s[i] + 1;
+		c->user[n].len = -1;
+		c->map[tag]    = ++n;
+	}
+	return 0;
+}
+
+/* Find the substitution for 'tag'; RETURNS NULL if there is none */
+static const char *
+substLookup(SubstCtx c, int tag, int *plen)
+{
+SubstUser u;
+
+	if ( c->map[(unsigned char)tag] ) {
+		u = &c->user[c->map[(unsigned char)tag] - 1];
+		if ( u->len < 0 )
+			u->len = strlen(u->val);
+		*plen = u->len;
+		return u->val;
+	}
+
+	if ( !c->builtin )
+		return 0;
+
+	if ( hostCacheLen < 0 )
+		pathSubstituteRefresh();
+
+	switch ( tag ) {
+		case 'H':
+			*plen = hostCacheLen;
+			return hostCache;
+
+		case 'D':
+			*plen = domCacheLen;
+			return domCache;
+
+		case 'I':
+			*plen = ipCacheLen;
+			return ipCache;
+
+		case 'S':
+			*plen = srvCacheLen;
+			return srvCache;
+
+		case 'B':
+			*plen = bspLen;
+			return GESYS_RTEMS_BSP;
+
+		case 'M':
+			*plen = macCacheLen;
+			return macCache;
+
+		case 'P':
+			/* cwd may change; read when needed (once per expansion) */
+			if ( !c->cwd && !(c->cwd = cwdbuf(0,0)) )
+				return 0;
+			*plen = strlen(c->cwd);
+			return c->cwd;
+
+		default:
+			break;
+	}
+	return 0;
+}
+
+/* Append 'len' chars to the output */
+static inline void
+substPut(char *buf, int size, int *pl, const char *str, int len)
+{
+int l = *pl;
+	if ( l < size ) {
+		memcpy(buf + l, str, l + len < size ? len : size - l);
+	}
+	*pl = l + len;
+}
+
+/* Emit the expansion of tag 'tag' */
+static inline void
+substTag(SubstCtx c, int tag, char *buf, int size, int *pl)
+{
+const char *v;
+int        vl;
+char       verb[2];
+
+	if ( '%' == tag ) {
+		substPut(buf, size, pl, "%", 1);
+	} else if ( (v = substLookup(c, tag, &vl)) ) {
+		substPut(buf, size, pl, v, vl);
+	} else {
+		/* no substitution found; copy verbatim */
+		verb[0] = '%';
+		verb[1] = tag;
+		substPut(buf, size, pl, verb, 2);
+	}
+}
+
+/* Expand 'p' in one pass; RETURNS the length of the expansion
+ * (which was truncated if >= size). 'buf' is always NUL-terminated
+ * if size > 0.
+ */
+static int
+substExpand(const char *p, SubstCtx c, char *buf, int size)
+{
+const char *lit;
+int        l = 0;
+
+	while ( *p ) {
+		for ( lit = p; *p && '%' != *p; p++ )
+			;
+		if ( p > lit )
+			substPut(buf, size, &l, lit, p - lit);
+		if ( !*p )
+			break;
+		/* '%' */
+		if ( !*++p ) {
+			/* trailing '%' */
+			substPut(buf, size, &l, "%", 1);
+			break;
+		}
+		substTag(c, *p++, buf, size, &l);
+	}
+
+	if ( size > 0 )
+		buf[l < size ? l : size - 1] = 0;
+	return l;
+}
+
+/* Expand into a malloc()ed string */
+static char *
+substAlloc(const char *p, SubstCtx c)
+{
+char buf[256];
+char *rval;
+int  l;
+
+	if ( !p )
+		return 0;
+
+	if ( (l = substExpand(p, c, buf, sizeof(buf))) < sizeof(buf) ) {
+		rval = malloc(l + 1);
+		if ( rval )
+			memcpy(rval, buf, l + 1);
+	} else {
+		/* didn't fit; expand again into a buffer of the right size */
+		if ( (rval = malloc(l + 1)) )
+			substExpand(p, c, rval, l + 1);
+	}
+	free(c->cwd);
+	c->cwd = 0;
+	return rval;
+}
+
 /* Allocate a new string substituting all '%<tagchar>' occurrences
  * in 'p' by substitutions listed in s[].
  * If no matching substitution is found, %<tagchar> is copied to
@@ -144,69 +505,18 @@ cleanup:
 char *
 stringSubstitute(const char *p, const char * const *s, int ns)
 {
-	register const char *pp;
-	register char       *dd;
-	char *rval;
-	int l,i,ch;
-
-	if ( !p )
+SubstCtxRec c;
+char        *rval;
+
+	/* the inline table needn't be cleared */
+	memset(&c.map, 0, sizeof(c.map));
+	c.builtin = 0;
+	c.cwd     = 0;
+	if ( substUserCompile(&c, s, ns) )
 		return 0;
-
-	for ( l = 0, rval = dd = 0; !rval; ) {
-		if ( l ) {
-			if ( ! (dd = rval = malloc(l+1)) )
-				return 0;
-		}
-		for ( pp=p; *pp; pp++ ) {
-			if ( '%' != *pp ) {
-				if ( dd )
-					*dd++ = *pp;
-				else
-					l++;
-			} else {
-				const char *ptmp = pp;
-
-				if ( (ch = *(pp+1)) ) {
-
-					if ( '%' == ch ) {
-						pp++;
-					} else {
-
-						for ( i = 0; i<ns; i++ ) {
-							if ( *s[i] == ch ) {
-								/* don't count initial substitution char
-								 * subtract 1 more char; will be added
-								 * again a few lines below...
-								 */
-								int ll = strlen(s[i]) - 1 - 1;
-								if ( dd ) {
-									strcpy(dd, s[i]+1);	
-									dd  += ll;
-									ptmp = dd;
-								} else {
-									l   += ll;
-								}
-								pp++;
-								break;
-							}
-						}
-						/* no substitution found; treat as ordinary '%'
-						 * (in case a substitution was found, the extra
-						 * char added here had been subtracted above)
-						 */
-					}
-				}
-				/* if % was the last char then this will just copy it */
-				if ( dd ) {
-					*dd++ = *ptmp;
-				} else {
-					l++;
-				}
-			}
-		}
-	}
-	*dd++ = 0;
-	assert( dd == rval + l + 1);
+	rval = substAlloc(p, &c);
+	if ( c.user != c.userBuf )
+		free(c.user);
 	return rval;
 }
 
@@ -247,64 +557,112 @@ char       *rval;
  *        %H -> hostname ('gethostname')
  *        %D -> domainname ('getdomainname')
  *        %P -> cwd ('getcwd')
- *        %I -> IP address (dot notation) [NOT SUPPORTED YET -- it's not trivial to find our IP address].
+ *        %I -> IP address (dot notation) of the first interface
+ *              which is up (excluding loopback)
+ *        %S -> boot server IP address (dot notation)
+ *        %B -> RTEMS BSP name (as configured)
+ *        %M -> MAC address (xx:xx:xx:xx:xx:xx) of the same interface as %I
+ *
+ * All values except for %P are read once and cached (see
+ * pathSubstituteRefresh()).
  *
  * RETURNS: newly allocated string (user must free())
  *          or NULL (no memory or gethostname etc. failure).
  */
 
-#define MAX_SUBST 4
-
-#define MAX_NAM 100
-
 char *
 pathSubstitute(const char *tmpl)
 {
-int  i;
-char *s[MAX_SUBST];
-int     ns = 0;
-char *rval = 0;
-char * const *sp = s;
-
-	for ( i=0; i<MAX_SUBST; i++ )
-		s[i] = 0;
-
-	if ( strstr(tmpl,"%H") ) {
-		if ( ! (s[ns] = malloc(MAX_NAM)) )
-			goto bail;
-		s[ns][0]='H';	/* tag char */
-		if ( gethostname(s[ns]+1,MAX_NAM - 1) ) {
-			/* gethostname failure */
-			goto bail;
-		}
-		ns++;
+SubstCtxRec c;
+
+	memset(&c, 0, sizeof(c));
+	c.builtin = 1;
+	return substAlloc(tmpl, &c);
+}
+
+/* Compile a template for repeated expansion with the
+ * pathSubstitute() tags.
+ *
+ * RETURNS: template object (release with pathTmplFree())
+ *          or NULL (no memory).
+ */
+PathTmpl
+pathTmplCompile(const char *tmpl)
+{
+PathTmpl    t;
+const char  *p;
+char        *cp;
+int         n, i;
+
+	if ( !tmpl )
+		return 0;
+
+	/* upper bound for the number of segments */
+	for ( n = 1, p = tmpl; *p; p++ ) {
+		if ( '%' == *p )
+			n += 2;
 	}
-	if ( strstr(tmpl,"%D") ) {
-		if ( ! (s[ns] = malloc(MAX_NAM)) )
-			goto bail;
-		s[ns][0]='D';	/* tag char */
-		if ( rtems_bsdnet_domain_name ) {
-			strncpy(s[ns]+1,rtems_bsdnet_domain_name, MAX_NAM - 1);
-			s[ns][MAX_NAM - 1] = 0;
+
+	if ( !(t = malloc(sizeof(*t) + n * sizeof(t->segs[0]) + strlen(tmpl) + 1)) )
+		return 0;
+
+	cp = (char*)&t->segs[n];
+	strcpy(cp, tmpl);
+
+	for ( i = 0, p = cp; *p; ) {
+		if ( '%' != *p ) {
+			t->segs[i].lit = p;
+			while ( *p && '%' != *p )
+				p++;
+			t->segs[i].len = p - t->segs[i].lit;
+			i++;
+		} else if ( !*++p ) {
+			t->segs[i].lit = "%";
+			t->segs[i].len = 1;
+			i++;
 		} else {
-			s[ns][1]=0;
+			t->segs[i].lit = 0;
+			t->segs[i].len = *p++;
+			i++;
 		}
-		ns++;
-	}
-	if ( strstr(tmpl,"%P") ) {
-		if ( ! (s[ns] = cwdbuf(1,0)) )
-			goto bail;
-		s[ns][0] = 'P';
-		ns++;
 	}
+	t->nsegs = i;
+	return t;
+}
 
-	rval = stringSubstitute(tmpl, (const char * const *)sp, ns);
+void
+pathTmplFree(PathTmpl t)
+{
+	free(t);
+}
 
-bail:
-	for ( i = 0; i<MAX_SUBST; i++ ) {
-		free(s[i]);
+/* Expand a compiled template into 'buf' (which holds 'size'
+ * chars). The result is truncated (but always NUL-terminated
+ * if size > 0) if it doesn't fit.
+ *
+ * RETURNS: length of the full expansion (i.e., the result was
+ *          truncated if this is >= size).
+ */
+int
+pathTmplExpand(PathTmpl t, char *buf, int size)
+{
+SubstCtxRec c;
+SubstSeg    sg;
+int         i, l = 0;
+
+	memset(&c, 0, sizeof(c));
+	c.builtin = 1;
+
+	for ( i = 0, sg = t->segs; i < t->nsegs; i++, sg++ ) {
+		if ( sg->lit )
+			substPut(buf, size, &l, sg->lit, sg->len);
+		else
+			substTag(&c, sg->len, buf, size, &l);
 	}
-	return rval;
+	if ( size > 0 )
+		buf[l < size ? l : size - 1] = 0;
+	free(c.cwd);
+	return l;
 }
 
 /* chdir to a path containing %H / %D substitutions */
@@ -323,12 +681,87 @@ int  rval = -1;
 #ifdef DEBUG_MAIN
 
 #include <stdio.h>
+#include <sys/time.h>
 
 static void
 usage(char *nm)
 {
-	fprintf(stderr,"Usage: %s [a] [-s <subst>] [-s <subst>] <path>\n",nm);
+	fprintf(stderr,"Usage: %s [a] [-b <loops>] [-s <subst>] [-s <subst>] <path>\n",nm);
 	fprintf(stderr,"       <subst> : 'subst_char' 'subst_string', e.g., Hhhh\n");
+	fprintf(stderr,"       -b      : benchmark <loops> expansions of <path>\n");
+}
+
+static double
+now()
+{
+struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+static void
+bench(const char *tmpl, const char **s, int ns, unsigned long loops)
+{
+unsigned long i;
+double        t;
+char          buf[1024];
+char          *p;
+PathTmpl      pt;
+int           l = 0;
+
+	t = now();
+	for ( i = 0; i < loops; i++ ) {
+		p = ns ? stringSubstitute(tmpl, s, ns) : pathSubstitute(tmpl);
+		free(p);
+	}
+	t = now() - t;
+	printf("%-24s %10.1f ns/expansion\n", ns ? "stringSubstitute():" : "pathSubstitute():", t/loops*1.0e9);
+
+	if ( ns )
+		return;
+
+	if ( !(pt = pathTmplCompile(tmpl)) ) {
+		fprintf(stderr,"pathTmplCompile failed\n");
+		return;
+	}
+	t = now();
+	for ( i = 0; i < loops; i++ ) {
+		l += pathTmplExpand(pt, buf, sizeof(buf));
+	}
+	t = now() - t;
+	printf("%-24s %10.1f ns/expansion (%.1f MB/s)\n", "pathTmplExpand():", t/loops*1.0e9, l/t/1.0e6);
+	pathTmplFree(pt);
+}
+
+/* expansion cost per tag (all but %P are cached) */
+static void
+benchTags(unsigned long loops)
+{
+static const char *tmpls[] = {
+	"/boot/iocBoot/plain/st.cmd",
+	"/boot/iocBoot/%H/st.cmd",
+	"/boot/iocBoot/%D/st.cmd",
+	"/boot/iocBoot/%I/st.cmd",
+	"/boot/iocBoot/%S/st.cmd",
+	"/boot/iocBoot/%B/st.cmd",
+	"/boot/iocBoot/%M/st.cmd",
+	"/boot/%B/%H.%D/%I/%M/%S",
+};
+unsigned long i;
+int           j;
+double        t;
+char          buf[1024];
+PathTmpl      pt;
+
+	for ( j = 0; j < sizeof(tmpls)/sizeof(tmpls[0]); j++ ) {
+		pt = pathTmplCompile(tmpls[j]);
+		t  = now();
+		for ( i = 0; i < loops; i++ )
+			pathTmplExpand(pt, buf, sizeof(buf));
+		t  = now() - t;
+		printf("%-28s %8.1f ns -> %s\n", tmpls[j], t/loops*1.0e9, buf);
+		pathTmplFree(pt);
+	}
 }
 
 int main(int argc, char **argv)
@@ -337,15 +770,19 @@ const char *s[20];
 int   ns = 0;
 char *p;
 int   ch;
+unsigned long loops = 0;
 
 	getdomainname(dombuf, sizeof(dombuf));
 
-	while ( (ch = getopt(argc, argv, "as:")) > 0 ) {
+	while ( (ch = getopt(argc, argv, "ab:s:")) > 0 ) {
 		switch ( ch ) {
 			case 'a':
 				addpathcwd(":",1);
 				printf("PATH=%s\n",getenv("PATH"));
 			break;
+			case 'b':
+				loops = strtoul(optarg, 0, 0);
+			break;
 			case 's':
 				if ( ns < sizeof(s)/sizeof(s[0]) ) {
 					s[ns]=optarg;
@@ -380,6 +817,12 @@ int   ch;
 	}
 	printf("%s\n",p);
 	free(p);
+
+	if ( loops ) {
+		bench(argv[optind], s, ns, loops);
+		benchTags(loops);
+	}
+	return 0;
 }
 #endif
 
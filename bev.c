@@ -1,3 +1,18 @@
+/* Boot environment (uC5282 flash) access
+ *
+ * The flash holds a linked list of GevHeader records. Walking it
+ * (with strcmp) on every getbenv() is slow since flash reads are;
+ * the list is therefore parsed once into a RAM index (all names
+ * and values copied into one string pool plus an open-addressing
+ * hash table) which then answers getbenv(). Validity and
+ * permissions of the records are preserved (prall() lists them).
+ *
+ * Host test/benchmark against a synthetic image: compile w/o
+ * __rtems__ defined:
+ *
+ *   cc -O2 -o bev bev.c
+ *   ./bev -n 100 -l 1000000
+ */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -5,10 +20,12 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __rtems__
 #include <rtems.h>
 #include <rtems/rtems_bsdnet.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#endif
 #include <stdlib.h>
 #include <ctype.h>
 
@@ -26,16 +43,173 @@ typedef struct GevHeader_ {
 #define GEV_NULL	((void*)0xffffffff)
 #define H_NULL(h)	(GEV_NULL==(h) || GEV_NULL==(h)->name)
 
-#define FORALLDO(h)	for ( h=(GevHeader)0xf0020000; !H_NULL(h); h=h->next )
+/* Where the environment lives in flash */
+#ifndef BEV_FLASH_BASE
+#define BEV_FLASH_BASE	0xf0020000
+#endif
+
+#define FORALLDO(h,base)	for ( h=(GevHeader)(base); !H_NULL(h); h=h->next )
+
+/* RAM copy of a record */
+typedef struct BevEntryRec_ {
+	const char	*name;
+	const char	*value;
+	unsigned	perm, valid;
+	unsigned	hash;
+} BevEntryRec, *BevEntry;
+
+typedef struct BevIndexRec_ {
+	int			nent;
+	int			mask;	/* slots - 1 */
+	BevEntry	ent;	/* in flash order            */
+	short		*slot;	/* index into 'ent' or -1    */
+	char		*pool;	/* names and values          */
+} BevIndexRec, *BevIndex;
+
+static BevIndex bevIdx = 0;
+
+static unsigned
+bevHash(const char *s)
+{
+unsigned h = 2166136261U;
+	while ( *s )
+		h = (h ^ (unsigned char)*s++) * 16777619U;
+	return h;
+}
+
+static void
+bevIndexFree(BevIndex idx)
+{
+	if ( idx ) {
+		free(idx->ent);
+		free(idx->slot);
+		free(idx->pool);
+		free(idx);
+	}
+}
+
+/* Parse the flash environment at 'base' into a new RAM index
+ * (which replaces a previous one).
+ *
+ * RETURNS: number of records on success, -1 on error (no memory).
+ */
+int
+bevIndexBuild(void *base)
+{
+GevHeader     h;
+BevIndex      idx;
+BevEntry      e;
+unsigned long plen = 0;
+int           n = 0, nslots, i, j;
+char          *p;
+
+	/* pass 1: count and size (each record is read only here and
+	 * in pass 2)
+	 */
+	FORALLDO(h, base) {
+		n++;
+		plen += strlen(h->name) + strlen(h->value) + 2;
+	}
+
+	for ( nslots = 8; nslots < 2*n; nslots <<= 1 )
+		;
+
+	if ( !(idx = calloc(1, sizeof(*idx))) )
+		return -1;
+
+	idx->nent = n;
+	idx->mask = nslots - 1;
+
+	if (   !(idx->ent  = malloc(sizeof(*idx->ent) * (n ? n : 1)))
+		|| !(idx->slot = malloc(sizeof(*idx->slot) * nslots))
+		|| !(idx->pool = malloc(plen ? plen : 1)) ) {
+		bevIndexFree(idx);
+		return -1;
+	}
+
+	/* pass 2: copy */
+	p = idx->pool;
+	e = idx->ent;
+	FORALLDO(h, base) {
+		e->name  = strcpy(p, h->name);  p += strlen(p) + 1;
+		e->value = strcpy(p, h->value); p += strlen(p) + 1;
+		e->perm  = h->perm;
+		e->valid = h->valid;
+		e->hash  = bevHash(e->name);
+		e++;
+	}
+
+	/* only valid records are hashed; the first one wins */
+	memset(idx->slot, 0xff, sizeof(*idx->slot) * nslots);
+	for ( i = 0, e = idx->ent; i < n; i++, e++ ) {
+		if ( !e->valid )
+			continue;
+		for ( j = e->hash & idx->mask; idx->slot[j] >= 0; j = (j + 1) & idx->mask ) {
+			if ( !strcmp(idx->ent[idx->slot[j]].name, e->name) )
+				break;
+		}
+		if ( idx->slot[j] < 0 )
+			idx->slot[j] = i;
+	}
+
+	/* values handed out by getbenv() point into the pool; hence
+	 * an old index is never released.
+	 */
+	bevIdx = idx;
+
+	return n;
+}
+
+/* the old way: walk the records (used if no index can be built) */
+static const char *
+getbenvLinear(void *base, const char *name)
+{
+GevHeader h;
+	FORALLDO(h, base) {
+		if ( !strcmp(name,h->name) && h->valid )
+			return h->value;
+	}
+	return 0;
+}
+
+static BevIndex
+bevIndexGet()
+{
+static int failed = 0;
+	/* Built on first use (normally from bev_network_setup(),
+	 * i.e., single-threaded). If that fails we don't try again
+	 * and the callers walk the flash records instead.
+	 */
+	if ( !bevIdx && !failed && bevIndexBuild((void*)BEV_FLASH_BASE) < 0 ) {
+		fprintf(stderr,"bevIndexBuild(): no memory; using linear lookup\n");
+		failed = 1;
+	}
+	return bevIdx;
+}
+
 void
 prall()
 {
+BevIndex idx = bevIndexGet();
+BevEntry e;
+int      i;
 GevHeader h;
-	FORALLDO(h) {
-		if ( !h->valid )
+	if ( !idx ) {
+		FORALLDO(h, (void*)BEV_FLASH_BASE) {
+			if ( !h->valid )
+				printf("  [");
+			printf("'%s=%s' (perm (sub): 0x%08x, valid: 0x%08x)", h->name, h->value, h->perm, h->valid);
+			if ( !h->valid )
+				printf("]");
+			printf("\n");
+		}
+		return;
+	}
+	for ( i = 0, e = idx->ent; i < idx->nent; i++, e++ ) {
+		if ( !e->valid )
 			printf("  [");
-		printf("'%s=%s' (perm (sub): 0x%08x, valid: 0x%08x)", h->name, h->value, h->perm, h->valid);
-		if ( !h->valid )
+		printf("'%s=%s' (perm (sub): 0x%08x, valid: 0x%08x)", e->name, e->value, e->perm, e->valid);
+		if ( !e->valid )
 			printf("]");
 		printf("\n");
 	}
@@ -44,15 +218,24 @@ GevHeader h;
 const char *
 getbenv(const char *name)
 {
-GevHeader h;
-	FORALLDO(h) {
-		if ( !strcmp(name,h->name) && h->valid )
-			return h->value;
+BevIndex idx = bevIndexGet();
+BevEntry e;
+unsigned h;
+int      j;
+
+	if ( !idx )
+		return getbenvLinear((void*)BEV_FLASH_BASE, name);
+
+	h = bevHash(name);
+	for ( j = h & idx->mask; idx->slot[j] >= 0; j = (j + 1) & idx->mask ) {
+		e = &idx->ent[idx->slot[j]];
+		if ( e->hash == h && !strcmp(name, e->name) )
+			return e->value;
 	}
 	return 0;
 }
 
-#ifndef HAVE_LIBNETBOOT
+#if defined(__rtems__) && !defined(HAVE_LIBNETBOOT)
 /* Use bsdnet fixup routine to retrieve flash variables and setup
  * the bsdnet_config.
  */
@@ -146,3 +329,118 @@ char *bootp = (char*)getbenv("DO_BOOTP");
 	return 0;
 }
 #endif
+
+#ifndef __rtems__
+#include <unistd.h>
+#include <sys/time.h>
+
+static double
+now()
+{
+struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+static void
+usage(char *nm)
+{
+	fprintf(stderr,"Usage: %s [-v] [-n <nvars>] [-l <loops>]\n", nm);
+	fprintf(stderr,"       build a synthetic flash environment, verify and\n");
+	fprintf(stderr,"       benchmark getbenv() against the linear list walk\n");
+}
+
+static const char *netvars[] = {
+	"IPADDR0", "NETMASK", "HOSTNAME", "DNS_DOMAIN", "GATEWAY", "LOGHOST",
+	"DNS_SERVER", "NTP_SERVER", "INIT", "DO_BOOTP", "SYS_SCRIPT",
+	"NOT_SET"
+};
+
+#define NNETVARS (sizeof(netvars)/sizeof(netvars[0]))
+
+int
+main(int argc, char **argv)
+{
+int           ch, nvars = 100, verb = 0, i, k, rval = 0;
+unsigned long loops = 1000000, l, sum = 0;
+GevHeader     img;
+char          buf[100];
+const char    *a, *b;
+double        t, tlin;
+
+	while ( (ch = getopt(argc, argv, "vn:l:")) > 0 ) {
+		switch ( ch ) {
+			case 'v': verb  = 1;                     break;
+			case 'n': nvars = strtoul(optarg, 0, 0); break;
+			case 'l': loops = strtoul(optarg, 0, 0); break;
+			default:
+				usage(argv[0]);
+			return 1;
+		}
+	}
+
+	/* synthetic image: the network vars (but the last one) are at the
+	 * end of the list; every fourth record is an invalidated older
+	 * version of the following one.
+	 */
+	k = nvars + NNETVARS - 1;
+	if ( !(img = calloc(k + 1, sizeof(*img))) )
+		return 1;
+	for ( i = 0; i < k; i++ ) {
+		if ( i < nvars ) {
+			sprintf(buf, "VAR_%i", (i & 3) ? i : i + 1);
+		} else {
+			strcpy(buf, netvars[i - nvars]);
+		}
+		img[i].name  = strdup(buf);
+		img[i].valid = (i < nvars && !(i & 3)) ? 0 : 1;
+		sprintf(buf, "value%s_%i", img[i].valid ? "" : "_old", i);
+		img[i].value = strdup(buf);
+		img[i].perm  = 0x111;
+		img[i].next  = &img[i+1];
+	}
+	img[k].name = GEV_NULL;
+
+	if ( (i = bevIndexBuild(img)) != k ) {
+		fprintf(stderr,"bevIndexBuild() failed (%i)\n", i);
+		return 1;
+	}
+	if ( verb )
+		prall();
+
+	/* verify */
+	for ( i = 0; i <= nvars + 1; i++ ) {
+		sprintf(buf, "VAR_%i", i);
+		a = getbenvLinear(img, buf);
+		b = getbenv(buf);
+		if ( a != b && (!a || !b || strcmp(a, b)) ) {
+			fprintf(stderr,"MISMATCH for %s: %s / %s\n", buf, a ? a : "(null)", b ? b : "(null)");
+			rval = 1;
+		}
+	}
+	for ( i = 0; i < NNETVARS; i++ ) {
+		a = getbenvLinear(img, netvars[i]);
+		b = getbenv(netvars[i]);
+		if ( a != b && (!a || !b || strcmp(a, b)) ) {
+			fprintf(stderr,"MISMATCH for %s: %s / %s\n", netvars[i], a ? a : "(null)", b ? b : "(null)");
+			rval = 1;
+		}
+	}
+
+	/* what bev_network_setup() does */
+	tlin = now();
+	for ( l = 0; l < loops; l++ )
+		sum += (unsigned long)getbenvLinear(img, netvars[l % NNETVARS]);
+	tlin = now() - tlin;
+
+	t = now();
+	for ( l = 0; l < loops; l++ )
+		sum += (unsigned long)getbenv(netvars[l % NNETVARS]);
+	t = now() - t;
+
+	printf("%i records; list walk: %.1f ns/lookup, indexed: %.1f ns/lookup -- %s\n",
+		k, tlin/loops*1.0e9, t/loops*1.0e9, rval ? "MISMATCH" : "OK");
+
+	return rval;
+}
+#endif
@@ -0,0 +1,152 @@
+/* Boot-phase timeline for the GeSys initialization task
+ *
+ * Init() (and gesys_network_start()) call 'gesysBootMark()'
+ * at every stage boundary. The marks are kept in a small
+ * static table which can be inspected from the Cexp shell:
+ *
+ *   gesysBootTimes()              -> print a table
+ *   gesysBootTimesDump("file")    -> write machine-readable
+ *                                    dump (NULL or "-" for stdout)
+ *
+ * The dump format is line-oriented; comment lines start with
+ * '#', all other lines read
+ *
+ *   <stage_name> <usecs_since_boot> <usecs_since_previous_mark>
+ *
+ * The host-side 'boottimediff' script compares two such dumps.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "verscheck.h"
+
+#ifndef GESYS_BOOT_MAX_MARKS
+#define GESYS_BOOT_MAX_MARKS	40
+#endif
+
+typedef struct BootMarkRec_ {
+	const char		*name;
+	unsigned long long	usecs;
+} BootMarkRec, *BootMark;
+
+static BootMarkRec	bootMarks[GESYS_BOOT_MAX_MARKS];
+static int		nBootMarks    = 0;
+static int		nBootDropped  = 0;
+
+extern const char *GeSys_Release_Name;
+extern const char *GeSys_Build_Date;
+
+/* microseconds since boot (high-resolution if the RTEMS
+ * version supports it; tick-resolution otherwise).
+ */
+static unsigned long long
+bootUsecs()
+{
+#if RTEMS_VERSION_ATLEAST(4,9,0)
+struct timespec now;
+	rtems_clock_get_uptime(&now);
+	return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec/1000;
+#else
+rtems_interval ticks, tps;
+	rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &ticks);
+	rtems_clock_get(RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps);
+	return (unsigned long long)ticks * 1000000ULL / tps;
+#endif
+}
+
+/* Record a stage boundary. 'stage' must be a string
+ * constant (only the pointer is stored) and should not
+ * contain white space (for the sake of the dump format).
+ * May be called from concurrent tasks.
+ */
+void
+gesysBootMark(const char *stage)
+{
+rtems_interrupt_level l;
+unsigned long long    now = bootUsecs();
+int                   i;
+
+	rtems_interrupt_disable(l);
+	if ( (i = nBootMarks) < GESYS_BOOT_MAX_MARKS ) {
+		nBootMarks++;
+	} else {
+		nBootDropped++;
+	}
+	rtems_interrupt_enable(l);
+
+	if ( i < GESYS_BOOT_MAX_MARKS ) {
+		bootMarks[i].name  = stage;
+		bootMarks[i].usecs = now;
+	}
+}
+
+/* Print the timeline as a table */
+void
+gesysBootTimes()
+{
+int                i;
+unsigned long long prev = 0;
+
+	printf("%-24s %12s %12s\n", "Stage", "Abs. [ms]", "Delta [ms]");
+	for ( i = 0; i < nBootMarks; i++ ) {
+		printf("%-24s %8llu.%03llu %8llu.%03llu\n",
+			bootMarks[i].name,
+			bootMarks[i].usecs/1000, bootMarks[i].usecs%1000,
+			(bootMarks[i].usecs - prev)/1000, (bootMarks[i].usecs - prev)%1000);
+		prev = bootMarks[i].usecs;
+	}
+	if ( nBootDropped )
+		printf("(%i marks dropped; table has only %i slots)\n", nBootDropped, GESYS_BOOT_MAX_MARKS);
+}
+
+/* Write the timeline in machine-readable form to
+ * file 'fname' (stdout if NULL or "-").
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+gesysBootTimesDump(const char *fname)
+{
+FILE               *f;
+int                i;
+unsigned long long prev = 0;
+char               hnam[64];
+
+	if ( !fname || !strcmp(fname, "-") ) {
+		f = stdout;
+	} else if ( !(f = fopen(fname, "w")) ) {
+		perror("gesysBootTimesDump(): opening file");
+		return -1;
+	}
+
+	if ( gethostname(hnam, sizeof(hnam)) )
+		strcpy(hnam, "unknown");
+	hnam[sizeof(hnam)-1] = 0;
+
+	fprintf(f, "# gesys-boottime 1\n");
+	fprintf(f, "# host %s\n",    hnam);
+	fprintf(f, "# release %s\n", GeSys_Release_Name);
+	fprintf(f, "# built %s\n",   GeSys_Build_Date);
+	fprintf(f, "# dropped %i\n", nBootDropped);
+	for ( i = 0; i < nBootMarks; i++ ) {
+		fprintf(f, "%s %llu %llu\n", bootMarks[i].name, bootMarks[i].usecs, bootMarks[i].usecs - prev);
+		prev = bootMarks[i].usecs;
+	}
+
+	if ( f != stdout ) {
+		if ( fclose(f) ) {
+			perror("gesysBootTimesDump(): closing file");
+			return -1;
+		}
+	} else {
+		fflush(f);
+	}
+	return 0;
+}
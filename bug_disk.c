@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <unistd.h>
@@ -16,22 +17,114 @@ typedef struct DiskioDescriptorRec_ {
     unsigned char   addr_mod;
 } DiskioDescriptorRec, *DiskioDescriptor;
 
+/* Number of 512-byte blocks requested per BUG disk read */
+#ifndef BUG_DISK_BATCH
+#define BUG_DISK_BATCH	128
+#endif
+
+#define BLKSZ	512
+
 #ifdef __rtems__
-static inline void read_blk(DiskioDescriptor d, int blkno)
+static inline void read_blks(DiskioDescriptor d, int blkno, int cnt)
 {
 	d->blk_num = blkno;
-	__asm__ __volatile__("mr 3,%0; mr 10,%1; sc"::"r"(d),"r"(0x10):"r3","r10");	
+	d->blk_cnt = cnt;
+	__asm__ __volatile__("mr 3,%0; mr 10,%1; sc"::"r"(d),"r"(0x10):"r3","r10","memory");	
 }
 #else
-#define creat(nm,mod) 0
-#define write(fd,buf,s) (s)
-#define close(fd)       (0)
-static inline void read_blk(DiskioDescriptor d, int blkno)
+#include <sys/time.h>
+
+static int           hostExtract = 0;
+static unsigned long hostSum;
+static unsigned long hostReads;
+
+/* FNV-1a over everything that would go into the filesystem */
+static void
+hostHash(const void *buf, size_t s)
 {
-	read(d->dev_lun, (void*)d->pbuf, 512); /* cheat, don't seek! */
+const unsigned char *p = buf;
+	while ( s-- > 0 )
+		hostSum = (hostSum ^ *p++) * 16777619UL;
+}
+
+static int
+hostCreat(const char *nm, mode_t mod)
+{
+	hostHash(nm, strlen(nm) + 1);
+	return hostExtract ? creat(nm, mod) : open("/dev/null", O_WRONLY);
+}
+
+static ssize_t
+hostWrite(int fd, const void *buf, size_t s)
+{
+	hostHash(buf, s);
+	return write(fd, buf, s);
+}
+
+static int
+hostMkdir(const char *nm, mode_t mod)
+{
+	hostHash(nm, strlen(nm) + 1);
+	return hostExtract ? mkdir(nm, mod) : 0;
+}
+
+#define creat(nm,mod)   hostCreat(nm,mod)
+#define write(fd,buf,s) hostWrite(fd,buf,s)
+#define mkdir(nm,mod)   hostMkdir(nm,mod)
+
+/* emulate the BUG: 'dev_lun' is a file descriptor */
+static inline void read_blks(DiskioDescriptor d, int blkno, int cnt)
+{
+ssize_t got;
+	d->blk_num = blkno;
+	d->blk_cnt = cnt;
+	hostReads++;
+	got = pread(d->dev_lun, (void*)d->pbuf, cnt*BLKSZ, (off_t)blkno*BLKSZ);
+	if ( got < 0 ) {
+		d->status = 1;
+		return;
+	}
+	/* reading past the end yields zeroes (= end of archive) */
+	memset((char*)d->pbuf + got, 0, cnt*BLKSZ - got);
+	d->status = 0;
 }
 #endif
 
+/* Window of BUG_DISK_BATCH blocks which is refilled by
+ * multi-block reads.
+ */
+typedef struct BlkWinRec_ {
+	DiskioDescriptorRec	d;
+	int					first, cnt;	/* blocks held in the window */
+	char				*buf;
+} BlkWinRec, *BlkWin;
+
+/* Make sure 'blkno' is in the window; RETURNS the number of
+ * consecutive blocks available starting at 'blkno' (0 on error).
+ */
+static int
+blkWinGet(BlkWin w, int blkno, char **pp)
+{
+	if ( blkno < w->first || blkno >= w->first + w->cnt ) {
+		w->d.pbuf = (unsigned long)w->buf;
+		read_blks(&w->d, blkno, BUG_DISK_BATCH);
+		w->cnt = BUG_DISK_BATCH;
+		if ( w->d.status ) {
+			/* may have hit the end of the disk; fall back to one block */
+			read_blks(&w->d, blkno, 1);
+			w->cnt = 1;
+			if ( w->d.status ) {
+				fprintf(stderr,"Reading disk block %i failed (status 0x%04x)\n", blkno, w->d.status);
+				w->cnt = 0;
+				return 0;
+			}
+		}
+		w->first = blkno;
+	}
+	*pp = w->buf + (blkno - w->first) * BLKSZ;
+	return w->first + w->cnt - blkno;
+}
+
 static unsigned long
 o2ul(char *chpt, int len)
 {
@@ -46,11 +139,12 @@ unsigned long rval;
 
 static int tar_chksum(char *chpt)
 {
+const unsigned char *p = (const unsigned char*)chpt;
 int rval = 0, i;
-	for ( i=0; i< 512; i++ )
-		rval += 0xff & chpt[i];
+	for ( i=0; i< 512; i+=4 )
+		rval += p[i] + p[i+1] + p[i+2] + p[i+3];
 	for ( i=148; i<156; i++)
-		rval += (0xff & ' ') - (0xff & chpt[i]);
+		rval += ' ' - p[i];
 	return rval;
 }
 
@@ -69,21 +163,25 @@ int rval = 0, i;
 int
 loadTarImg(int verb, int lun)
 {
-char          		buf[512];
-int           		blkno, chks, i;
+char          		*buf, *p;
+int           		blkno, chks, i, n, rval = -1;
 unsigned			mode,size;
 unsigned char		type;
-DiskioDescriptorRec d = {0};
+BlkWinRec			w;
 
-	d.dev_lun = lun;
-	d.blk_cnt = 1;
-	d.pbuf    = (unsigned long)buf;
+	memset(&w, 0, sizeof(w));
+	w.d.dev_lun = lun;
+	if ( !(w.buf = malloc(BUG_DISK_BATCH * BLKSZ)) ) {
+		fprintf(stderr,"loadTarImg: no memory for read buffer\n");
+		return -1;
+	}
 
 	blkno = 0;
 
 	do {
 
-		read_blk(&d, blkno++);
+		if ( !blkWinGet(&w, blkno++, &buf) )
+			goto bail;
 
 		if ( strncmp(buf+257, "ustar  ", 7) )
 			break;
@@ -111,39 +209,166 @@ DiskioDescriptorRec d = {0};
 		}
 		if ( i!=chks ) {
 			fprintf(stderr,"Checksum mismatch (read %i, calculated %i)\n", chks, i);
-			return -1;
+			goto bail;
 		}
 		if ( ' ' == type ) {
 			if ( (i = creat(buf, mode)) < 0 ) {
 				perror("creating file");
-				return -1;
+				goto bail;
 			}
+			/* write as much as the window holds at once */
 			while ( size > 0 ) {
-				chks = size >= 512 ? 512 : size;
-				read_blk(&d, blkno++);
-				if ( chks!=write(i,buf,chks) ) {
+				if ( !(n = blkWinGet(&w, blkno, &p)) ) {
+					close(i);
+					goto bail;
+				}
+				chks   = size >= n*BLKSZ ? n*BLKSZ : size;
+				blkno += (chks + BLKSZ - 1)/BLKSZ;
+				if ( chks!=write(i,p,chks) ) {
 					perror("writing block");
 					close(i);
-					return -1;
+					goto bail;
 				}
 				size -= chks;
 			}
 			if ( close(i) ) {
 				perror("close");
-				return -1;
+				goto bail;
 			}
 		} else if ( 'd' == type ) {
 			mkdir(buf, S_IRWXU | S_IRWXG | S_IRWXO);
 		}
 	} while (1);
 
-	return 0;
+	rval = 0;
+
+bail:
+	free(w.buf);
+	return rval;
 }
 
 #ifndef __rtems__
+static void
+usage(char *nm)
+{
+	fprintf(stderr,"Usage: %s [-v] [-n <loops>] [-o <dir>] <tar_image>...\n",nm);
+	fprintf(stderr,"       Benchmark loadTarImg() (batch size %i blocks) and verify\n", BUG_DISK_BATCH);
+	fprintf(stderr,"       that its output matches single-block reads.\n");
+	fprintf(stderr,"       -o : extract into <dir> (default: discard)\n");
+}
+
+static double
+now()
+{
+struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+/* reference implementation: one block per read and write */
+static int
+loadTarImgRef(int lun)
+{
+char          		buf[BLKSZ];
+int           		blkno, i;
+unsigned			size, chks;
+DiskioDescriptorRec d = {0};
+
+	d.dev_lun = lun;
+	d.pbuf    = (unsigned long)buf;
+
+	for ( blkno = 0 ;; ) {
+		read_blks(&d, blkno++, 1);
+		if ( strncmp(buf+257, "ustar  ", 7) )
+			return 0;
+		size = o2ul(buf+124,12);
+		if ( tar_chksum(buf) != (int)o2ul(buf+148,8) )
+			return -1;
+		if ( LF_OLDNORMAL == buf[156] || LF_NORMAL == buf[156] ) {
+			if ( (i = creat(buf, 0)) < 0 )
+				return -1;
+			for ( ; size > 0; size -= chks ) {
+				chks = size >= BLKSZ ? BLKSZ : size;
+				read_blks(&d, blkno++, 1);
+				write(i, buf, chks);
+			}
+			close(i);
+		} else if ( LF_DIR == buf[156] ) {
+			mkdir(buf, 0);
+		}
+	}
+}
+
 int
 main(int argc, char **argv)
 {
-	loadTarImg(1,0);
+int           ch, fd, cwd, verb = 0, loops = 1, l, rval = 0;
+const char    *odir = 0;
+unsigned long refSum, refReads, sum, reads;
+double        t, tref;
+struct stat   sb;
+
+	while ( (ch = getopt(argc, argv, "vn:o:")) > 0 ) {
+		switch ( ch ) {
+			case 'v': verb  = 1;                        break;
+			case 'n': loops = strtoul(optarg, 0, 0);    break;
+			case 'o': odir  = optarg;                   break;
+			default:
+				usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ( optind >= argc ) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for ( ; optind < argc; optind++ ) {
+		if ( (fd = open(argv[optind], O_RDONLY)) < 0 || fstat(fd, &sb) ) {
+			perror(argv[optind]);
+			rval = 1;
+			continue;
+		}
+
+		hostSum = 2166136261UL; hostReads = 0;
+		tref = now();
+		for ( l = 0; l < loops; l++ )
+			loadTarImgRef(fd);
+		tref = (now() - tref) / loops;
+		refSum = hostSum; refReads = hostReads / loops;
+
+		if ( odir && ((cwd = open(".", O_RDONLY)) < 0 || chdir(odir)) ) {
+			perror("chdir");
+			return 1;
+		}
+		hostExtract = !!odir;
+		hostSum = 2166136261UL; hostReads = 0;
+		t = now();
+		for ( l = 0; l < loops; l++ ) {
+			if ( loadTarImg(verb && !l, fd) ) {
+				fprintf(stderr,"%s: loadTarImg() failed\n", argv[optind]);
+				rval = 1;
+				break;
+			}
+			hostExtract = 0;
+		}
+		t = (now() - t) / loops;
+		if ( odir && (fchdir(cwd) || close(cwd)) ) {
+			perror("fchdir");
+			return 1;
+		}
+		sum = hostSum; reads = hostReads / loops;
+
+		printf("%s: %lu bytes; 1-block: %lu reads %.3fms; %i-block: %lu reads %.3fms (%.1f MB/s) -- %s\n",
+			argv[optind], (unsigned long)sb.st_size,
+			refReads, tref*1000., BUG_DISK_BATCH, reads, t*1000.,
+			t > 0 ? sb.st_size/t/1.0e6 : 0.,
+			refSum == sum ? "OK" : "MISMATCH");
+		if ( refSum != sum )
+			rval = 1;
+		close(fd);
+	}
+	return rval;
 }
 #endif
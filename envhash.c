@@ -0,0 +1,349 @@
+/* Hashed index for the environment
+ *
+ * newlib's getenv() scans 'environ' linearly (under the env lock).
+ * With 100+ variables from the command line / BOOTP and frequent
+ * lookups (e.g., by EPICS during iocInit) this adds up.
+ *
+ * This module wraps getenv(), setenv(), putenv() and unsetenv()
+ * (link with -Wl,--wrap,getenv -Wl,--wrap,setenv
+ * -Wl,--wrap,putenv -Wl,--wrap,unsetenv; see configure's
+ * --enable-envhash):
+ *
+ *  - writers call the real routine under the env lock and then
+ *    rebuild an open-addressing hash table of 'environ' into the
+ *    spare one of two tables which is then published.
+ *  - readers take no lock. A generation count tells them if a
+ *    writer published a new table while they were looking; they
+ *    then retry. The result is also validated against 'environ'
+ *    so modifications which bypass the wrappers (e.g., by code
+ *    loaded at run-time which references the real getenv/setenv,
+ *    see the note in gc.cc about wrapping and the Cexp symbol
+ *    table) are detected and handled by the real getenv().
+ *
+ * Environment strings are never freed by newlib (setenv leaks
+ * the old string when growing a value), hence a reader looking at
+ * a stale entry never dereferences freed memory.
+ *
+ * Host benchmark: compile with -DDEBUG_MAIN
+ *
+ *   cc -DDEBUG_MAIN -O2 -o envhash envhash.c
+ *   ./envhash -n 150 -l 1000000
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifndef DEBUG_MAIN
+#include <reent.h>
+extern void __env_lock(struct _reent *);
+extern void __env_unlock(struct _reent *);
+
+extern char *__real_getenv(const char *);
+extern int   __real_setenv(const char *, const char *, int);
+extern int   __real_putenv(char *);
+extern int   __real_unsetenv(const char *);
+#else
+#define __env_lock(x)   do { } while (0)
+#define __env_unlock(x) do { } while (0)
+#define __real_getenv   getenv
+#define __real_setenv   setenv
+#define __real_putenv   putenv
+#define __real_unsetenv unsetenv
+#endif
+
+extern char **environ;
+
+/* Slots per table (power of two); the index is only used if
+ * the environment has at most half as many entries.
+ */
+#ifndef ENVHASH_SLOTS
+#define ENVHASH_SLOTS	1024
+#endif
+
+#if ( ENVHASH_SLOTS & (ENVHASH_SLOTS - 1) )
+#error "ENVHASH_SLOTS must be a power of two"
+#endif
+
+#define ENVHASH_MASK	(ENVHASH_SLOTS - 1)
+
+#define BARRIER()	__asm__ __volatile__("":::"memory")
+
+typedef struct EnvSlotRec_ {
+	const char	*str;	/* "NAME=value" as found in environ[idx] */
+	unsigned	hash;
+	int			idx;
+} EnvSlotRec, *EnvSlot;
+
+typedef struct EnvTabRec_ {
+	char		**env;	/* 'environ' when the table was built */
+	int			envc;
+	EnvSlotRec	slot[ENVHASH_SLOTS];
+} EnvTabRec, *EnvTab;
+
+static EnvTabRec          envTabs[2];
+static EnvTab volatile    envCur = 0;
+static volatile unsigned  envGen = 0;
+
+/* Statistics */
+static unsigned long envHits, envMisses, envFallbacks, envRebuilds;
+
+/* FNV-1a over the name (up to '=' or NUL); length in *plen */
+static inline unsigned
+envHash(const char *s, int *plen)
+{
+unsigned   h = 2166136261U;
+const char *p;
+	for ( p = s; *p && '=' != *p; p++ )
+		h = (h ^ (unsigned char)*p) * 16777619U;
+	*plen = p - s;
+	return h;
+}
+
+/* Rebuild the index; must be called with the env lock held */
+static void
+envRebuild()
+{
+EnvTab   t = (envCur == &envTabs[0]) ? &envTabs[1] : &envTabs[0];
+char     **e = environ;
+int      i, n, len;
+unsigned h, j;
+
+	envRebuilds++;
+
+	for ( n = 0; e && e[n]; n++ )
+		;
+
+	if ( n > ENVHASH_SLOTS/2 ) {
+		/* too many; readers use the real getenv() */
+		envCur = 0;
+		BARRIER();
+		envGen++;
+		return;
+	}
+
+	/* we are the only writer; readers may still be looking at
+	 * this table (if it was published two generations ago) but
+	 * they will notice the generation change and retry.
+	 */
+	envGen++;
+	BARRIER();
+
+	memset(t->slot, 0, sizeof(t->slot));
+	t->env  = e;
+	t->envc = n;
+
+	/* insert in reverse order so the first occurrence wins */
+	for ( i = n - 1; i >= 0; i-- ) {
+		h = envHash(e[i], &len);
+		for ( j = h & ENVHASH_MASK; t->slot[j].str; j = (j + 1) & ENVHASH_MASK ) {
+			if ( t->slot[j].hash == h && !strncmp(t->slot[j].str, e[i], len + 1) )
+				break;
+		}
+		t->slot[j].str  = e[i];
+		t->slot[j].hash = h;
+		t->slot[j].idx  = i;
+	}
+
+	BARRIER();
+	envCur = t;
+	BARRIER();
+	envGen++;
+}
+
+char *
+envHashGetenv(const char *name)
+{
+EnvTab     t;
+EnvSlot    s;
+unsigned   g, h, j;
+int        len, tries;
+const char *rval;
+
+	if ( !name )
+		return 0;
+
+	h = envHash(name, &len);
+
+	for ( tries = 0; tries < 4; tries++ ) {
+		g = envGen;
+		BARRIER();
+		if ( !(t = envCur) )
+			break;
+
+		rval = 0;
+		for ( j = h & ENVHASH_MASK; (s = &t->slot[j])->str; j = (j + 1) & ENVHASH_MASK ) {
+			if ( s->hash == h && !strncmp(s->str, name, len) && '=' == s->str[len] ) {
+				rval = s->str;
+				break;
+			}
+		}
+
+		/* validate against the current environment */
+		if ( environ != t->env || environ[t->envc] )
+			break;
+		if ( rval && environ[s->idx] != rval )
+			break;
+
+		BARRIER();
+		if ( g == envGen ) {
+			if ( rval ) {
+				envHits++;
+				return (char*)rval + len + 1;
+			}
+			envMisses++;
+			return 0;
+		}
+	}
+
+	envFallbacks++;
+	return __real_getenv(name);
+}
+
+char *
+__wrap_getenv(const char *name)
+{
+	return envHashGetenv(name);
+}
+
+int
+__wrap_setenv(const char *name, const char *value, int overwrite)
+{
+int rval;
+	__env_lock(_REENT);
+	rval = __real_setenv(name, value, overwrite);
+	envRebuild();
+	__env_unlock(_REENT);
+	return rval;
+}
+
+int
+__wrap_putenv(char *str)
+{
+int rval;
+	__env_lock(_REENT);
+	rval = __real_putenv(str);
+	envRebuild();
+	__env_unlock(_REENT);
+	return rval;
+}
+
+int
+__wrap_unsetenv(const char *name)
+{
+int rval;
+	__env_lock(_REENT);
+	rval = __real_unsetenv(name);
+	envRebuild();
+	__env_unlock(_REENT);
+	return rval;
+}
+
+/* Rebuild the index (e.g., after 'environ' was modified directly) */
+void
+envHashRefresh()
+{
+	__env_lock(_REENT);
+	envRebuild();
+	__env_unlock(_REENT);
+}
+
+/* Print statistics */
+void
+envHashStats()
+{
+	printf("Environment index: %s (%i slots)\n",
+		envCur ? "active" : "inactive", ENVHASH_SLOTS);
+	printf("  %lu hits, %lu misses, %lu fallbacks to linear search, %lu rebuilds\n",
+		envHits, envMisses, envFallbacks, envRebuilds);
+}
+
+#ifdef DEBUG_MAIN
+
+#include <unistd.h>
+#include <sys/time.h>
+
+static double
+now()
+{
+struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec/1.0e6;
+}
+
+static void
+usage(char *nm)
+{
+	fprintf(stderr,"Usage: %s [-n <nvars>] [-l <loops>]\n", nm);
+	fprintf(stderr,"       compare getenv() of the host C library with the hashed index\n");
+}
+
+int main(int argc, char **argv)
+{
+int           ch, nvars = 150, i;
+unsigned long loops = 1000000, l, sum;
+char          nam[64], val[64];
+char          **names;
+double        t;
+char          *a, *b;
+
+	while ( (ch = getopt(argc, argv, "n:l:h")) > 0 ) {
+		switch ( ch ) {
+			case 'n': nvars = strtoul(optarg, 0, 0); break;
+			case 'l': loops = strtoul(optarg, 0, 0); break;
+			default:
+				usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ( !(names = malloc(sizeof(*names) * (nvars + 1))) )
+		return 1;
+
+	for ( i = 0; i < nvars; i++ ) {
+		sprintf(nam, "EPICS_VAR_%04i", i);
+		sprintf(val, "value_of_%04i", i);
+		__wrap_setenv(nam, val, 1);
+		names[i] = strdup(nam);
+	}
+	names[nvars] = "NOT_DEFINED_ANYWHERE";
+
+	/* correctness */
+	for ( i = 0; i <= nvars; i++ ) {
+		a = getenv(names[i]);
+		b = envHashGetenv(names[i]);
+		if ( a != b ) {
+			fprintf(stderr,"MISMATCH for %s: %s / %s\n", names[i], a ? a : "(null)", b ? b : "(null)");
+			return 1;
+		}
+	}
+	__wrap_unsetenv(names[0]);
+	__wrap_putenv("EPICS_VAR_0001=changed");
+	if ( envHashGetenv(names[0]) || strcmp(envHashGetenv(names[1]), "changed") ) {
+		fprintf(stderr,"unsetenv/putenv not reflected\n");
+		return 1;
+	}
+	__wrap_setenv(names[0], "back", 1);
+
+	printf("%i variables (+ %i from the host environment), %lu lookups each:\n",
+		nvars, (int)(envCur ? envCur->envc - nvars : 0), loops);
+
+	t = now();
+	for ( l = sum = 0; l < loops; l++ )
+		sum += (unsigned long)getenv(names[l % (nvars + 1)]);
+	t = now() - t;
+	printf("  linear getenv():  %8.1f ns/lookup\n", t/loops*1.0e9);
+
+	t = now();
+	for ( l = 0; l < loops; l++ )
+		sum -= (unsigned long)envHashGetenv(names[l % (nvars + 1)]);
+	t = now() - t;
+	printf("  hashed getenv():  %8.1f ns/lookup\n", t/loops*1.0e9);
+
+	envHashStats();
+	return sum ? 1 : 0;
+}
+#endif
@@ -1,5 +1,5 @@
 
-/* Copy data from the SVGM board flash area to a scratch file
+/* Load a module from the SVGM board flash area
  *
  * This file is of limited usefulness on boards other than
  * the Synergy Microsystem's SVGM series SBC and it is NOT
@@ -47,25 +47,64 @@
  * this notice affixed to any distribution by the recipient that contains a
  * copy or derivative of this software.
  */
+#include <rtems.h>
+#include <rtems/libio.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <errno.h>
 
+/* The flash bank holds a 32-bit length followed by the module.
+ *
+ * If the module is stored as a (single-member) ustar archive
+ * then the flash is mounted with rtems_tarfs_load() which creates
+ * a file referencing the flash in place -- no RAM copy at all.
+ * Otherwise the module is copied (in one go) into a buffer which
+ * is exposed as a file with memFileCreate(), avoiding the IMFS
+ * write path.
+ *
+ * NOTE: the flash window is banked; the file is only valid while
+ * 'bank' is selected, i.e., until cexpFlashSymLoad() returns.
+ */
+
+#define TAR_MAGIC_OFF	257
+#define TAR_HDR_SIZE	512
+
 int
 cexpModuleLoad(char*,char*);
 
+void *
+memFileAlloc(size_t len);
+
+void
+memFileFree(void *data);
+
+int
+memFileCreate(const char *path, void *data, size_t len, int owned);
+
+int
+memFileRelease(const char *path);
+
+extern size_t
+malloc_free_space();
+
 void
 cexpFlashSymLoad(unsigned char bank)
 {
 unsigned char	*flashctrl=(unsigned char*)0xffeffe50;
 unsigned char	*flash    =(unsigned char*)0xfff80000;
-int				fd;
 struct	stat	stbuf;
-int				len,i,written;
-char 			tmpfname[30]={
-				        '/','t','m','p','/','m','o','d','X','X','X','X','X','X',
-					        0};
+int				len, st;
+void			*buf = 0;
+char			dirname[30], fname[30 + 100];
+rtems_interval	t0, t1, tps;
+size_t			free0, free1;
+static unsigned	seq = 0;
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+	free0 = malloc_free_space();
 
 	/* switch to desired bank */
 	*flashctrl=(1<<7)|bank;
@@ -75,28 +114,56 @@ char 			tmpfname[30]={
 		mkdir("/tmp",0777);
 		umask(old);
 	}
-	if ( (fd=mkstemp(tmpfname)) < 0) {
-		perror("creating scratch file");
-		goto cleanup;
-	}
 
 	len=*(unsigned long*)flash;
 	flash+=sizeof(unsigned long);
 
-	printf("Copying %i bytes\n",len);
-	for (i=written=0; i < len; i+=written ) {
-		written=write(fd,flash+i,len-i);
-		if (written<=0)
-			break;
-	}
-	close(fd);
-	if (written<0) {
-		perror("writing to tempfile\n");
+	dirname[0] = 0;
+	fname[0]   = 0;
+
+	if ( len > TAR_HDR_SIZE && !memcmp(flash + TAR_MAGIC_OFF, "ustar", 5) ) {
+		/* zero-copy; mount the archive into a private directory */
+		sprintf(dirname, "/tmp/flash%u", seq++);
+		if ( mkdir(dirname, 0777) ) {
+			perror("creating flash directory");
+			dirname[0] = 0;
+			goto cleanup;
+		}
+		if ( (st = rtems_tarfs_load(dirname, flash, len)) ) {
+			fprintf(stderr,"Mounting flash archive failed (rtems_tarfs_load: %i)\n", st);
+			goto cleanup;
+		}
+		/* the first member is the module */
+		sprintf(fname, "%s/%.99s", dirname, (char*)flash);
+		printf("Mapped %i bytes of flash\n",len);
 	} else {
-		printf("OK, ready to load\n");
-		cexpModuleLoad(tmpfname,0);
+		if ( !(buf = memFileAlloc(len)) ) {
+			fprintf(stderr,"No memory for %i bytes of flash\n", len);
+			goto cleanup;
+		}
+		memcpy(buf, flash, len);
+		sprintf(fname, "/tmp/mod%u", seq++);
+		if ( memFileCreate(fname, buf, len, 1) ) {
+			fname[0] = 0;
+			memFileFree(buf);
+			goto cleanup;
+		}
+		printf("Copied %i bytes\n",len);
 	}
 
+	free1 = malloc_free_space();
+	printf("OK, ready to load\n");
+	cexpModuleLoad(fname,0);
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+	printf("Flash module loaded in %lums; heap used for staging: %lu bytes\n",
+		(unsigned long)(t1 - t0) * 1000UL / tps,
+		(unsigned long)(free0 > free1 ? free0 - free1 : 0));
+
 cleanup:
-	unlink(tmpfname);
+	if ( fname[0] && memFileRelease(fname) )
+		unlink(fname);
+	if ( dirname[0] )
+		rmdir(dirname);
 }
@@ -1,5 +1,8 @@
 #include <rtems++/rtemsTask.h>
-#include <rtems++/rtemsMessageQueue.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "verscheck.h"
 
 /* Author: Till Straumann, <strauman@slac.stanford.edu>, 2003/10/8 */
 
@@ -17,10 +20,20 @@
  *
  * if _Thread_Dispatch_disable_level > 0, the
  * 'arg' to 'free(arg)' is deposited in a
- * mailbox from where it is picked up by a
+ * ring buffer from where it is picked up by a
  * low priority thread executing the 'real'
  * 'free()' in its context where it is safe.
  *
+ * The mechanism has been generalized into a deferred-work
+ * executor: any {function, argument} pair can be posted from
+ * ISR or dispatch-disabled code with
+ *
+ *    gesysDefer(GESYS_DEFER_HIGH or GESYS_DEFER_LOW, fn, arg)
+ *
+ * and is executed in batches by a worker task of the respective
+ * priority (the LOW worker is the GC task which also handles
+ * free()).
+ *
  * We use the C++ API to save typing and to
  * use C++ static constructors for transparent
  * initialization...
@@ -44,63 +57,270 @@
 
 #undef DEBUG
 
-/* a GC task object (derived from rtemsTask) */
-class rtemsGCHack : public rtemsTask {
+/* Requests are passed from ISR/dispatch-disabled code to a worker
+ * task through a ring buffer of GESYS_GC_RING_DEPTH records (must
+ * be a power of two). The producer only disables interrupts for
+ * the few instructions it takes to claim a slot; the worker drains
+ * the ring in batches.
+ * Generic requests are rejected if the ring is full. A block to be
+ * free()d is linked into an 'overflow' list instead (the block
+ * itself holds the link) so nothing is ever lost.
+ */
+#ifndef GESYS_GC_RING_DEPTH
+#define GESYS_GC_RING_DEPTH	64
+#endif
+
+#if ( GESYS_GC_RING_DEPTH & (GESYS_GC_RING_DEPTH - 1) )
+#error "GESYS_GC_RING_DEPTH must be a power of two"
+#endif
+
+/* worker priorities */
+#ifndef GESYS_DEFER_HIGH_PRIO
+#define GESYS_DEFER_HIGH_PRIO	30
+#endif
+#ifndef GESYS_DEFER_LOW_PRIO
+#define GESYS_DEFER_LOW_PRIO	200
+#endif
+
+/* worker stack size; generic requests run arbitrary code */
+#ifndef GESYS_DEFER_STACK
+#define GESYS_DEFER_STACK		(4*RTEMS_MINIMUM_STACK_SIZE)
+#endif
+
+/* worker selectors for gesysDefer() */
+#define GESYS_DEFER_HIGH	0
+#define GESYS_DEFER_LOW		1
+#define GESYS_DEFER_NUM		2
+
+#define GC_RING_MASK	(GESYS_GC_RING_DEPTH - 1)
+#define GC_EVENT		RTEMS_EVENT_0
+
+/* Telemetry (gesysDeferStats()); time-to-execution is histogrammed
+ * in clock ticks with logarithmic bins: 0, 1, 2-3, 4-7, ...
+ * Counters are not updated atomically; they are meant for
+ * sizing the ring and spotting starvation, not for accounting.
+ */
+#define GC_HIST_BINS	16
+
+typedef struct GCStatsRec_ {
+	unsigned long	direct;		/* freed in the caller's context       */
+	unsigned long	deferred;	/* handed to the worker                */
+	unsigned long	overflows;	/* ring was full; used overflow list   */
+	unsigned long	dropped;	/* ring was full; request rejected     */
+	unsigned long	early;		/* posted before the worker existed    */
+	unsigned long	batches;	/* worker wakeups                      */
+	unsigned		peakDepth;	/* max. ring occupancy                 */
+	unsigned long	hist[GC_HIST_BINS];
+	rtems_interval	maxTicks;
+} GCStatsRec;
+
+typedef void (*DeferFn)(void*);
+
+typedef struct DeferRec_ {
+	DeferFn			fn;
+	void			*arg;
+	rtems_interval	stamp;
+} DeferRec;
+
+extern "C" void __real_free(void*);
+
+#ifdef DEBUG
+extern "C" void printk(const char *,...);
+#endif
+
+/* may be called from ISR or dispatch-disabled code */
+static inline rtems_interval gcTicks()
+{
+#if RTEMS_VERSION_ATLEAST(4,9,0)
+	return rtems_clock_get_ticks_since_boot();
+#else
+rtems_interval t;
+	rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t);
+	return t;
+#endif
+}
+
+/* a deferred-work task object (derived from rtemsTask) */
+class rtemsDeferWorker : public rtemsTask {
 public:
-	/* default constructor: creates a task and mailbox and then
-     * starts the task
+	/* constructor: creates and starts the task.
+	 * The workers are static objects, i.e., zero-initialized before
+	 * any constructor runs. free() may be called (from another
+	 * constructor) before this one ran; the ring, the overflow list
+	 * and 'wakePending' must therefore not be reset here. If such
+	 * early requests are pending the worker is woken right away.
+	 */
+	rtemsDeferWorker(const char *name, rtems_task_priority prio)
+		:rtemsTask(name, prio, GESYS_DEFER_STACK)
+		{
+			this->start(0);
+			tid = this->id_is();
+			if ( wakePending )
+				rtems_event_send(tid, GC_EVENT);
+		}
+
+	/* post a request; may be called from ISR or dispatch-disabled
+	 * code. RETURNS: 0 on success, -1 if the ring is full.
 	 */
-	rtemsGCHack()
-		:rtemsTask("GCHk", 200, RTEMS_MINIMUM_STACK_SIZE),
-		 q("GCHk", 5, sizeof(void*))
-		{ this->start(0); }
-
-	/* send a request */
-	void requestFree(void *ptr)
-		{ this->q.send(static_cast<void*>(&ptr), sizeof(ptr)); };
+	int  post(DeferFn fn, void *arg);
+
+	/* post a free() request; never fails */
+	void requestFree(void *ptr);
+
+	GCStatsRec        stats;
 protected:
 	/* we have to implement the body of our task, see below */
-	virtual void rtemsGCHack::body(rtems_task_argument unused);
+	virtual void body(rtems_task_argument unused);
 private:
-	/* a small message queue to pass requests from dispatch-disabled
-	 * sections to the GC thread
-	 */
-	rtemsMessageQueue q;
+	int  enqueue(DeferFn fn, void *arg);
+	void wakeup(int wake);
+
+	DeferRec          ring[GESYS_GC_RING_DEPTH];
+	/* 'head' is only written by producers, 'tail' only by the worker */
+	volatile unsigned head, tail;
+	void * volatile   overflow;
+	volatile int      wakePending;
+	rtems_id          tid;
 };
 
-extern "C" void __real_free(void*);
+/* claim a slot; must be called with interrupts disabled */
+inline int rtemsDeferWorker::enqueue(DeferFn fn, void *arg)
+{
+unsigned d;
+DeferRec *r;
 
-#ifdef DEBUG
-extern "C" void printk(const char *,...);
-#endif
+	if ( (d = head - tail) >= GESYS_GC_RING_DEPTH )
+		return -1;
+	r        = &ring[head & GC_RING_MASK];
+	r->fn    = fn;
+	r->arg   = arg;
+	r->stamp = gcTicks();
+	head++;
+	if ( ++d > stats.peakDepth )
+		stats.peakDepth = d;
+	stats.deferred++;
+	return 0;
+}
+
+inline void rtemsDeferWorker::wakeup(int wake)
+{
+	/* sending an event is OK from ISR or dispatch-disabled code;
+	 * the worker runs once dispatching is re-enabled.
+	 */
+	if ( wake ) {
+		if ( tid )
+			rtems_event_send(tid, GC_EVENT);
+		else
+			stats.early++;
+	}
+}
+
+int rtemsDeferWorker::post(DeferFn fn, void *arg)
+{
+rtems_interrupt_level l;
+int                   wake = 0, rval;
+
+	rtems_interrupt_disable(l);
+		if ( (rval = enqueue(fn, arg)) ) {
+			stats.dropped++;
+		} else {
+			wake        = !wakePending;
+			wakePending = 1;
+		}
+	rtems_interrupt_enable(l);
+
+	wakeup(wake);
+	return rval;
+}
+
+void rtemsDeferWorker::requestFree(void *ptr)
+{
+rtems_interrupt_level l;
+int                   wake;
+
+	rtems_interrupt_disable(l);
+		if ( enqueue(__real_free, ptr) ) {
+			*(void**)ptr = overflow;
+			overflow     = ptr;
+			stats.overflows++;
+			stats.deferred++;
+		}
+		wake        = !wakePending;
+		wakePending = 1;
+	rtems_interrupt_enable(l);
+
+	wakeup(wake);
+}
 
-/* The GC task body */
-void rtemsGCHack::body(rtems_task_argument unused)
+/* The worker task body */
+void rtemsDeferWorker::body(rtems_task_argument unused)
 {
-void             *ptr;
-uint32_t s = sizeof(ptr);
+rtems_event_set       evs;
+rtems_interrupt_level l;
+unsigned              h;
+void                  *ptr, *nxt;
+DeferRec              *r;
+rtems_interval        dt;
+int                   bin;
 
 #ifdef DEBUG
-	printk("GC thread started...\n");
+	printk("Deferred-work thread started...\n");
 #endif
 
 	while (1) {
 		/* wait for a request */
-		this->q.receive(static_cast<void*>(&ptr),s);
+		rtems_event_receive(GC_EVENT, RTEMS_WAIT | RTEMS_EVENT_ANY, RTEMS_NO_TIMEOUT, &evs);
+
+		/* requests arriving from now on must wake us again */
+		wakePending = 0;
+		stats.batches++;
+
+		/* drain the ring */
+		while ( (h = head) != tail ) {
+			while ( tail != h ) {
+				r = &ring[tail & GC_RING_MASK];
 #ifdef DEBUG
-		printk("GC thread freeing 0x%x\n",ptr);
+				printk("Deferred-work thread calling 0x%x(0x%x)\n",r->fn,r->arg);
 #endif
-		/* and do the real free() here */
-		__real_free(ptr);
+				/* and do the real work (e.g., free()) here */
+				r->fn(r->arg);
+				dt  = gcTicks() - r->stamp;
+				tail++;
+				if ( dt > stats.maxTicks )
+					stats.maxTicks = dt;
+				for ( bin = 0; dt && bin < GC_HIST_BINS - 1; dt >>= 1 )
+					bin++;
+				stats.hist[bin]++;
+			}
+		}
+
+		/* and the overflow list */
+		rtems_interrupt_disable(l);
+			ptr      = overflow;
+			overflow = 0;
+		rtems_interrupt_enable(l);
+
+		for ( ; ptr; ptr = nxt ) {
+			nxt = *(void**)ptr;
+			__real_free(ptr);
+		}
 	}
 }
 
-/* a single object; is transparently and automatically initialized :-) */
-static rtemsGCHack theHack;
+/* the workers; transparently and automatically initialized :-) */
+static rtemsDeferWorker hiWorker("DFhi", GESYS_DEFER_HIGH_PRIO);
+static rtemsDeferWorker theHack ("GCHk", GESYS_DEFER_LOW_PRIO);
+
+static rtemsDeferWorker * const workers[GESYS_DEFER_NUM] = {
+	&hiWorker,
+	&theHack,
+};
 
 /* this replaces the LIBC 'free' */
 extern "C" void __wrap_free(void *arg)
 {
+	if ( !arg )
+		return;
 	if (_Thread_Dispatch_disable_level > 0) {
 		/* if they call us from a dispatch disabled section, just
 		 * post a request to the GC task and return
@@ -108,6 +328,181 @@ extern "C" void __wrap_free(void *arg)
 		theHack.requestFree(arg);
 	} else {
 		/* otherwise, proceed as usual */
+		theHack.stats.direct++;
 		__real_free(arg);
 	}
 }
+
+/* Execute 'fn(arg)' in the context of worker 'which' (GESYS_DEFER_HIGH
+ * or GESYS_DEFER_LOW). May be called from ISRs and dispatch-disabled
+ * code.
+ *
+ * RETURNS: 0 on success, -1 if the request could not be queued.
+ */
+extern "C" int gesysDefer(int which, void (*fn)(void*), void *arg)
+{
+	if ( which < 0 || which >= GESYS_DEFER_NUM || !fn )
+		return -1;
+	return workers[which]->post(fn, arg);
+}
+
+/* Reset deferred-work statistics */
+extern "C" void gesysDeferStatsReset()
+{
+int i;
+	for ( i = 0; i < GESYS_DEFER_NUM; i++ )
+		memset(&workers[i]->stats, 0, sizeof(workers[i]->stats));
+}
+
+static void
+printStats(const char *name, int prio, GCStatsRec *st, rtems_interval tps)
+{
+int i;
+
+	printf("%s (priority %i): ring depth %i, peak occupancy %u\n", name, prio, GESYS_GC_RING_DEPTH, st->peakDepth);
+	if ( st->direct )
+		printf("  direct    %10lu\n", st->direct);
+	printf("  deferred  %10lu (in %lu batches)\n", st->deferred, st->batches);
+	if ( st->overflows )
+		printf("  overflows %10lu (ring full; free() via overflow list)\n", st->overflows);
+	printf("  dropped   %10lu (ring full; request rejected)\n", st->dropped);
+	printf("  early     %10lu (before worker was started)\n", st->early);
+	printf("  time-to-execution (ticks @%lu/s), max %lu:\n", (unsigned long)tps, (unsigned long)st->maxTicks);
+	for ( i = 0; i < GC_HIST_BINS; i++ ) {
+		if ( !st->hist[i] )
+			continue;
+		if ( i < 2 )
+			printf("  %8i        : %10lu\n", i, st->hist[i]);
+		else if ( i < GC_HIST_BINS - 1 )
+			printf("  %8lu-%-7lu: %10lu\n", 1UL<<(i-1), (1UL<<i)-1, st->hist[i]);
+		else
+			printf("  >=%-13lu: %10lu\n", 1UL<<(i-1), st->hist[i]);
+	}
+}
+
+/* Print (and optionally reset) deferred-work statistics */
+extern "C" void gesysDeferStats(int reset)
+{
+GCStatsRec     st[GESYS_DEFER_NUM];
+rtems_interval tps;
+int            i;
+
+	for ( i = 0; i < GESYS_DEFER_NUM; i++ )
+		st[i] = workers[i]->stats;
+
+	if ( reset )
+		gesysDeferStatsReset();
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	printStats("High-priority worker",       GESYS_DEFER_HIGH_PRIO, &st[GESYS_DEFER_HIGH], tps);
+	printStats("Low-priority worker (free)", GESYS_DEFER_LOW_PRIO,  &st[GESYS_DEFER_LOW],  tps);
+}
+
+/* Compatibility aliases */
+extern "C" void gesysGCStats(int reset)
+{
+	gesysDeferStats(reset);
+}
+
+extern "C" void gesysGCStatsReset()
+{
+	gesysDeferStatsReset();
+}
+
+/* Benchmark (from the Cexp shell): gesysDeferBench(which, n)
+ *  - enqueue cost: post batches of no-op requests with preemption
+ *    disabled (so the worker cannot run in between),
+ *  - end-to-end latency: post one request at a time and wait for
+ *    the worker to execute it.
+ */
+static unsigned long long
+benchUsecs()
+{
+#if RTEMS_VERSION_ATLEAST(4,9,0)
+struct timespec now;
+	rtems_clock_get_uptime(&now);
+	return (unsigned long long)now.tv_sec * 1000000ULL + now.tv_nsec/1000;
+#else
+rtems_interval ticks, tps;
+	rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &ticks);
+	rtems_clock_get(RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps);
+	return (unsigned long long)ticks * 1000000ULL / tps;
+#endif
+}
+
+typedef struct BenchRec_ {
+	rtems_id           sync;
+	unsigned long long t0, sum, max;
+	volatile unsigned  done;
+} BenchRec;
+
+static void benchNop(void *arg)
+{
+	((BenchRec*)arg)->done++;
+}
+
+static void benchLatency(void *arg)
+{
+BenchRec           *b = (BenchRec*)arg;
+unsigned long long dt = benchUsecs() - b->t0;
+	b->sum += dt;
+	if ( dt > b->max )
+		b->max = dt;
+	rtems_semaphore_release(b->sync);
+}
+
+extern "C" int gesysDeferBench(int which, int n)
+{
+BenchRec           b;
+unsigned long long t, tot = 0;
+int                i, k, batch = GESYS_GC_RING_DEPTH / 2, posted = 0;
+rtems_mode         mode;
+
+	if ( which < 0 || which >= GESYS_DEFER_NUM || n <= 0 ) {
+		fprintf(stderr,"Usage: gesysDeferBench(which = 0 (high) / 1 (low), n)\n");
+		return -1;
+	}
+
+	memset(&b, 0, sizeof(b));
+	if ( RTEMS_SUCCESSFUL != rtems_semaphore_create(
+				rtems_build_name('D','F','B','n'),
+				0,
+				RTEMS_SIMPLE_BINARY_SEMAPHORE | RTEMS_FIFO,
+				0,
+				&b.sync) ) {
+		fprintf(stderr,"gesysDeferBench: unable to create semaphore\n");
+		return -1;
+	}
+
+	/* enqueue cost */
+	for ( i = 0; i < n; i += batch ) {
+		k = n - i < batch ? n - i : batch;
+		rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &mode);
+		t = benchUsecs();
+		while ( k-- > 0 ) {
+			if ( 0 == workers[which]->post(benchNop, &b) )
+				posted++;
+		}
+		tot += benchUsecs() - t;
+		rtems_task_mode(mode, RTEMS_PREEMPT_MASK, &mode);
+		/* let a low-priority worker catch up */
+		while ( b.done < (unsigned)posted )
+			rtems_task_wake_after(1);
+	}
+	printf("enqueue: %i requests in %lluus (%llu ns/request)\n",
+		n, tot, n ? tot * 1000ULL / n : 0ULL);
+
+	/* end-to-end latency */
+	for ( i = 0; i < n; i++ ) {
+		b.t0 = benchUsecs();
+		if ( workers[which]->post(benchLatency, &b) )
+			break;
+		rtems_semaphore_obtain(b.sync, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+	}
+	printf("latency: %i requests, avg %lluus, max %lluus\n",
+		i, i ? b.sum / i : 0ULL, b.max);
+
+	rtems_semaphore_delete(b.sync);
+	return 0;
+}
@@ -0,0 +1,3 @@
+# IOC startup script
+ld("../modules/drvFoo.obj")
+ld("../modules/devBar.obj")
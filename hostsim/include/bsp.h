@@ -0,0 +1 @@
+/* Host simulation: no BSP */
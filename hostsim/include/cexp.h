@@ -0,0 +1,15 @@
+/* Host simulation: Cexp entry points (simcexp.c) */
+#ifndef GESYS_HOSTSIM_CEXP_H
+#define GESYS_HOSTSIM_CEXP_H
+
+#define CEXP_MAIN_INVAL_ARG	1
+#define CEXP_MAIN_NO_SYMS	2
+#define CEXP_MAIN_NO_SCRIPT	3
+#define CEXP_MAIN_NO_MEM	4
+#define CEXP_MAIN_KILLED	5
+
+int cexpInit(void *excHandlerInstall);
+int cexp_main(int argc, char **argv);
+void *cexpModuleLoad(char *file, char *name);
+
+#endif
@@ -0,0 +1,4 @@
+/* Host simulation: configuration of init.c */
+#define PACKAGE_VERSION		"hostsim"
+#define NFS_SUPPORT		1
+#define TFTP_SUPPORT		1
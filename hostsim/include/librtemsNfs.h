@@ -0,0 +1,10 @@
+/* Host simulation: NFS client (simnet.c) */
+#ifndef GESYS_HOSTSIM_LIBRTEMSNFS_H
+#define GESYS_HOSTSIM_LIBRTEMSNFS_H
+
+int rpcUdpInit(void);
+int nfsInit(int smallPoolDepth, int bigPoolDepth);
+int nfsMount(char *uidhost, char *path, char *mntpoint);
+int unmount(const char *mntpoint);
+
+#endif
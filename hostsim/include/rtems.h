@@ -0,0 +1,122 @@
+/* Host simulation: subset of the RTEMS Classic API used by init.c
+ * (implemented on top of pthreads by simrtems.c)
+ */
+#ifndef GESYS_HOSTSIM_RTEMS_H
+#define GESYS_HOSTSIM_RTEMS_H
+
+#include <stdint.h>
+#include <time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define __RTEMS_MAJOR__		4
+#define __RTEMS_MINOR__		10
+#define __RTEMS_REVISION__	2
+#define RTEMS_VERSION		"4.10.2 (host simulation)"
+
+/* init.c tests the version before including verscheck.h */
+#define RTEMS_VERSION_LATER_THAN(ma,mi,re) \
+	(    __RTEMS_MAJOR__  > (ma)	\
+	 || (__RTEMS_MAJOR__ == (ma) && __RTEMS_MINOR__  > (mi))	\
+	 || (__RTEMS_MAJOR__ == (ma) && __RTEMS_MINOR__ == (mi) && __RTEMS_REVISION__ > (re)) \
+    )
+#define RTEMS_VERSION_ATLEAST(ma,mi,re) \
+	(    __RTEMS_MAJOR__  > (ma)	\
+	 || (__RTEMS_MAJOR__ == (ma) && __RTEMS_MINOR__  > (mi))	\
+	 || (__RTEMS_MAJOR__ == (ma) && __RTEMS_MINOR__ == (mi) && __RTEMS_REVISION__ >= (re)) \
+    )
+
+typedef enum {
+	RTEMS_SUCCESSFUL         = 0,
+	RTEMS_TOO_MANY           = 5,
+	RTEMS_INVALID_ID         = 4,
+	RTEMS_NOT_DEFINED        = 11,
+	RTEMS_UNSATISFIED        = 13,
+	RTEMS_INCORRECT_STATE    = 14,
+	RTEMS_INTERNAL_ERROR     = 25
+} rtems_status_code;
+
+typedef uint32_t      rtems_id;
+typedef uint32_t      rtems_name;
+typedef uint32_t      rtems_interval;
+typedef uint32_t      rtems_task_priority;
+typedef uint32_t      rtems_attribute;
+typedef uint32_t      rtems_mode;
+typedef unsigned long rtems_task_argument;
+typedef void          rtems_task;
+typedef rtems_task  (*rtems_task_entry)(rtems_task_argument);
+typedef int           rtems_interrupt_level;
+
+typedef struct {
+	uint32_t year, month, day, hour, minute, second, ticks;
+} rtems_time_of_day;
+
+typedef enum {
+	RTEMS_CLOCK_GET_TOD,
+	RTEMS_CLOCK_GET_SECONDS_SINCE_EPOCH,
+	RTEMS_CLOCK_GET_TICKS_SINCE_BOOT,
+	RTEMS_CLOCK_GET_TICKS_PER_SECOND,
+	RTEMS_CLOCK_GET_TIME_VALUE
+} rtems_clock_get_options;
+
+#define rtems_build_name(c1,c2,c3,c4) \
+	((rtems_name)(((c1)<<24) | ((c2)<<16) | ((c3)<<8) | (c4)))
+
+#define RTEMS_SELF                 ((rtems_id)0)
+#define RTEMS_CURRENT_PRIORITY     0
+#define RTEMS_MINIMUM_STACK_SIZE   4096
+#define RTEMS_DEFAULT_MODES        0
+#define RTEMS_DEFAULT_ATTRIBUTES   0
+#define RTEMS_FLOATING_POINT       0x0001
+#define RTEMS_LOCAL                0
+#define RTEMS_FIFO                 0
+#define RTEMS_PRIORITY             0x0004
+#define RTEMS_COUNTING_SEMAPHORE   0
+#define RTEMS_BINARY_SEMAPHORE     0x0010
+#define RTEMS_SIMPLE_BINARY_SEMAPHORE 0x0020
+#define RTEMS_INHERIT_PRIORITY     0x0040
+#define RTEMS_WAIT                 0
+#define RTEMS_NO_WAIT              1
+#define RTEMS_NO_TIMEOUT           0
+
+rtems_status_code
+rtems_task_create(rtems_name, rtems_task_priority, size_t, rtems_mode, rtems_attribute, rtems_id *);
+rtems_status_code
+rtems_task_start(rtems_id, rtems_task_entry, rtems_task_argument);
+rtems_status_code
+rtems_task_delete(rtems_id);
+rtems_status_code
+rtems_task_suspend(rtems_id);
+rtems_status_code
+rtems_task_set_priority(rtems_id, rtems_task_priority, rtems_task_priority *);
+rtems_status_code
+rtems_task_wake_after(rtems_interval);
+
+rtems_status_code
+rtems_semaphore_create(rtems_name, uint32_t, rtems_attribute, rtems_task_priority, rtems_id *);
+rtems_status_code
+rtems_semaphore_obtain(rtems_id, uint32_t, rtems_interval);
+rtems_status_code
+rtems_semaphore_release(rtems_id);
+rtems_status_code
+rtems_semaphore_delete(rtems_id);
+
+rtems_status_code
+rtems_clock_get(rtems_clock_get_options, void *);
+rtems_status_code
+rtems_clock_set(rtems_time_of_day *);
+rtems_status_code
+rtems_clock_get_uptime(struct timespec *);
+
+const char *
+rtems_status_text(rtems_status_code);
+
+/* one global lock stands in for disabling interrupts */
+void simIrqLock(void);
+void simIrqUnlock(void);
+#define rtems_interrupt_disable(l)	do { (l) = 0; simIrqLock();   } while (0)
+#define rtems_interrupt_enable(l)	do { (void)(l); simIrqUnlock(); } while (0)
+
+#endif
@@ -0,0 +1,10 @@
+/* Host simulation */
+#ifndef GESYS_HOSTSIM_LIBIO_H
+#define GESYS_HOSTSIM_LIBIO_H
+
+#include <rtems.h>
+
+rtems_status_code
+rtems_libio_set_private_env(void);
+
+#endif
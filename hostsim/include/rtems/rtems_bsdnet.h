@@ -0,0 +1,44 @@
+/* Host simulation: networking configuration and BOOTP results
+ * (filled in from SIM_* environment variables, see simnet.c)
+ */
+#ifndef GESYS_HOSTSIM_RTEMS_BSDNET_H
+#define GESYS_HOSTSIM_RTEMS_BSDNET_H
+
+#include <rtems.h>
+#include <netinet/in.h>
+
+struct rtems_bsdnet_ifconfig {
+	char                         *name;
+	int                         (*attach)(struct rtems_bsdnet_ifconfig *, int);
+	struct rtems_bsdnet_ifconfig *next;
+	char                         *ip_address;
+	char                         *ip_netmask;
+};
+
+struct rtems_bsdnet_config {
+	struct rtems_bsdnet_ifconfig *ifconfig;
+	void                        (*bootp)(void);
+	int                           network_task_priority;
+	unsigned long                 mbuf_bytecount;
+	unsigned long                 mbuf_cluster_bytecount;
+	char                         *hostname;
+	char                         *domainname;
+	char                         *gateway;
+	char                         *log_host;
+	char                         *name_server[3];
+	char                         *ntp_server[3];
+};
+
+extern struct rtems_bsdnet_config rtems_bsdnet_config;
+extern struct in_addr             rtems_bsdnet_bootp_server_address;
+extern char                      *rtems_bsdnet_bootp_boot_file_name;
+extern char                      *rtems_bsdnet_bootp_cmdline;
+extern int                        rtems_bsdnet_ntpserver_count;
+
+int
+rtems_bsdnet_initialize_network(void);
+
+int
+rtems_bsdnet_synchronize_ntp(int interval, rtems_task_priority prio);
+
+#endif
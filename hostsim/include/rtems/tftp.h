@@ -0,0 +1 @@
+/* Host simulation: TFTP is simulated by the path layer (pathcheck.c) */
@@ -0,0 +1,168 @@
+/* Host simulation of the path helpers (nvram/pathcheck.c)
+ *
+ * This file is #included by init.c (hostsim/Makefile compiles a
+ * copy of init.c so that this version is found rather than the
+ * one from 'nvram'). It implements the same interface with
+ * simplified parsing:
+ *
+ *   /TFTP/<host>/<path>                       TFTP
+ *   [<uid>.<gid>@][<host>]:<export>:<path>    NFS
+ *   [<host>:]~<user>/<path>                   RSH (not simulated)
+ *   /<path>                                   local
+ *   <path>                                    relative to 'path_prefix'
+ */
+#include "sim.h"
+
+#define LOCAL_PATH	0
+#define TFTP_PATH	1
+#define NFS_PATH	2
+#define RSH_PATH	3
+#define INVAL_PATH	(-1)
+
+#define INVALID_SPEC	(-11)
+
+typedef struct MntDescRec_ {
+	char *mntpt;
+	char *uidhost;
+	char *rpath;
+} MntDescRec, *MntDesc;
+
+static char *path_prefix = 0;
+static char *dflt_fname  = 0;
+
+static int
+pathType(char *path)
+{
+char *col;
+
+	if ( !path )
+		return INVAL_PATH;
+	if ( 0 == strncmp(path, "/TFTP/", 6) )
+		return TFTP_PATH;
+	if ( strchr(path, '~') )
+		return RSH_PATH;
+	if ( (col = strchr(path, ':')) && strchr(col + 1, ':') )
+		return NFS_PATH;
+	if ( '/' == *path )
+		return LOCAL_PATH;
+	/* relative; interpret according to the default prefix */
+	if ( path_prefix )
+		return pathType(path_prefix);
+	return LOCAL_PATH;
+}
+
+/* Build the TFTP file name and, if 'perrfd' is non-NULL, open it.
+ *
+ * RETURNS: descriptor (or 0 if not opened) on success, < 0 on error.
+ */
+static int
+isTftpPath(char **pDfltSrv, char *path, int *perrfd, char **pfname)
+{
+char *fn;
+int  fd = 0;
+
+	if ( perrfd )
+		*perrfd = -1;
+
+	if ( '/' == *path ) {
+		fn = strdup(path);
+	} else {
+		if ( !path_prefix )
+			return INVALID_SPEC;
+		fn = malloc(strlen(path_prefix) + strlen(path) + 1);
+		strcat(strcpy(fn, path_prefix), path);
+	}
+
+	if ( perrfd && (fd = open(fn, O_RDONLY)) < 0 ) {
+		free(fn);
+		return -1;
+	}
+	*pfname = fn;
+	return fd;
+}
+
+/* Parse an NFS path spec into 'm' and the file name below the
+ * mount point; if 'perrfd' is non-NULL mount (unless the same
+ * export is already mounted) and open the file.
+ *
+ * RETURNS: descriptor (or 0 if not opened) on success, < 0 on error.
+ */
+static int
+isNfsPath(char **pDfltSrv, char *path, int *perrfd, char **pfname, MntDesc m)
+{
+char *spec, *c1, *c2, *host, *fn;
+int  fd = 0;
+
+	if ( perrfd )
+		*perrfd = -1;
+
+	if ( !(spec = strdup(path)) )
+		return -1;
+	c1 = strchr(spec, ':');
+	c2 = c1 ? strchr(c1 + 1, ':') : 0;
+	if ( !c2 ) {
+		free(spec);
+		return INVALID_SPEC;
+	}
+	*c1++ = 0;
+	*c2++ = 0;
+
+	host = *spec ? spec : (pDfltSrv && *pDfltSrv ? *pDfltSrv : 0);
+	if ( !host ) {
+		free(spec);
+		return INVALID_SPEC;
+	}
+
+	if ( m->uidhost && m->rpath && (strcmp(m->uidhost, host) || strcmp(m->rpath, c1)) ) {
+		/* a different export is still mounted there */
+		if ( perrfd && unmount(m->mntpt) ) {
+			free(spec);
+			return -1;
+		}
+		free(m->uidhost); m->uidhost = 0;
+		free(m->rpath);   m->rpath   = 0;
+	}
+
+	if ( !m->uidhost ) {
+		m->uidhost = strdup(host);
+		m->rpath   = strdup(c1);
+		if ( perrfd && nfsMount(m->uidhost, m->rpath, m->mntpt) ) {
+			free(m->uidhost); m->uidhost = 0;
+			free(m->rpath);   m->rpath   = 0;
+			free(spec);
+			return -1;
+		}
+	}
+
+	fn = malloc(strlen(m->mntpt) + strlen(c2) + 2);
+	sprintf(fn, "%s%s%s", m->mntpt, '/' == *c2 ? "" : "/", c2);
+	free(spec);
+
+	if ( perrfd && (fd = open(fn, O_RDONLY)) < 0 ) {
+		free(fn);
+		return -1;
+	}
+	*pfname = fn;
+	return fd;
+}
+
+static int
+isRshPath(char **pDfltSrv, char *path, int *perrfd, char **pfname)
+{
+	fprintf(stderr,"SIM: RSH is not simulated\n");
+	return -1;
+}
+
+/* Unmount and forget the export described by 'm'
+ *
+ * RETURNS: 0 on success (or if nothing was mounted).
+ */
+static int
+releaseMount(MntDesc m)
+{
+	if ( m->uidhost && unmount(m->mntpt) )
+		return -1;
+	free(m->uidhost); m->uidhost = 0;
+	free(m->rpath);   m->rpath   = 0;
+	return 0;
+}
@@ -0,0 +1,342 @@
+/* Host simulation of the GeSys initialization task
+ *
+ * Runs Init() (init.c) on Linux against simulated RTEMS, network,
+ * TFTP/NFS and Cexp layers. The simulated environment is set up
+ * from environment variables (see README):
+ *
+ *   SIM_ROOT          directory holding the simulated filesystems
+ *                     (tftp/, nfs/<export>/, local/)
+ *   SIM_<OP>_MS       latency of operation <OP> (NETIF, NTP, RPC,
+ *                     NFSINIT, MOUNT, TFTP, NFS, LOAD)
+ *   SIM_FAIL          comma-separated list of <op>[:<n>]; the first
+ *                     <n> (default: all) attempts of <op> fail
+ *
+ * The paths used by init.c are mapped into SIM_ROOT by wrapping
+ * open(), chdir(), mkdir() and unlink() (link with --wrap).
+ */
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "sim.h"
+
+extern rtems_task Init(rtems_task_argument);
+extern void       gesysBootTimes(void);
+extern int        gesysBootTimesDump(const char *);
+
+extern int        __real_open(const char *, int, ...);
+extern int        __real_chdir(const char *);
+extern int        __real_mkdir(const char *, mode_t);
+extern int        __real_unlink(const char *);
+extern int        __real_getchar(void);
+
+extern void       simNetInit(void);
+
+const char        *simRoot = ".";
+
+#define SIM_MAX_OPS	16
+
+typedef struct SimOpRec_ {
+	const char *name;
+	int         failures;	/* remaining failures; -1: always */
+	unsigned    calls, failed;
+} SimOpRec, *SimOp;
+
+static SimOpRec        simOps[SIM_MAX_OPS];
+static int             nSimOps = 0;
+static pthread_mutex_t simOpLock = PTHREAD_MUTEX_INITIALIZER;
+
+static char            simCwd[PATH_MAX] = "/";
+
+static SimOp
+simOpFind(const char *name)
+{
+int i;
+	for ( i = 0; i < nSimOps; i++ ) {
+		if ( 0 == strcmp(simOps[i].name, name) )
+			return &simOps[i];
+	}
+	if ( nSimOps >= SIM_MAX_OPS )
+		return 0;
+	simOps[nSimOps].name     = strdup(name);
+	simOps[nSimOps].failures = 0;
+	return &simOps[nSimOps++];
+}
+
+/* parse SIM_FAIL */
+static void
+simFailInit()
+{
+char *str, *tok, *col, *sav;
+SimOp o;
+
+	if ( !getenv("SIM_FAIL") || !(str = strdup(getenv("SIM_FAIL"))) )
+		return;
+	for ( tok = strtok_r(str, ", ", &sav); tok; tok = strtok_r(0, ", ", &sav) ) {
+		if ( (col = strchr(tok, ':')) )
+			*col++ = 0;
+		if ( (o = simOpFind(tok)) )
+			o->failures = col ? atoi(col) : -1;
+	}
+	free(str);
+}
+
+int
+simOp(const char *op)
+{
+char          var[40], *val;
+unsigned long ms = 0;
+SimOp         o;
+int           rval = 0;
+int           i;
+
+	snprintf(var, sizeof(var), "SIM_%s_MS", op);
+	for ( i = 4; var[i]; i++ )
+		var[i] = toupper((unsigned char)var[i]);
+	if ( (val = getenv(var)) )
+		ms = strtoul(val, 0, 0);
+	if ( ms )
+		usleep(ms * 1000);
+
+	pthread_mutex_lock(&simOpLock);
+	if ( (o = simOpFind(op)) ) {
+		o->calls++;
+		if ( o->failures ) {
+			if ( o->failures > 0 )
+				o->failures--;
+			o->failed++;
+			rval = -1;
+		}
+	}
+	pthread_mutex_unlock(&simOpLock);
+
+	if ( rval )
+		fprintf(stderr,"SIM: '%s' failed (injected)\n", op);
+	return rval;
+}
+
+/* NFS mounts */
+typedef struct SimMntRec_ {
+	char *mntpt;
+	char *export;
+} SimMntRec;
+
+#define SIM_MAX_MOUNTS	8
+static SimMntRec       simMounts[SIM_MAX_MOUNTS];
+static pthread_mutex_t simMntLock = PTHREAD_MUTEX_INITIALIZER;
+
+int
+simMountAdd(const char *mntpt, const char *export)
+{
+int i, rval = -1;
+	pthread_mutex_lock(&simMntLock);
+	for ( i = 0; i < SIM_MAX_MOUNTS; i++ ) {
+		if ( simMounts[i].mntpt && 0 == strcmp(simMounts[i].mntpt, mntpt) ) {
+			errno = EBUSY;
+			goto bail;
+		}
+	}
+	for ( i = 0; i < SIM_MAX_MOUNTS; i++ ) {
+		if ( !simMounts[i].mntpt ) {
+			simMounts[i].mntpt  = strdup(mntpt);
+			simMounts[i].export = strdup(export);
+			rval = 0;
+			goto bail;
+		}
+	}
+	errno = ENOMEM;
+bail:
+	pthread_mutex_unlock(&simMntLock);
+	return rval;
+}
+
+int
+simMountDel(const char *mntpt)
+{
+int i;
+	pthread_mutex_lock(&simMntLock);
+	for ( i = 0; i < SIM_MAX_MOUNTS; i++ ) {
+		if ( simMounts[i].mntpt && 0 == strcmp(simMounts[i].mntpt, mntpt) ) {
+			free(simMounts[i].mntpt);
+			free(simMounts[i].export);
+			simMounts[i].mntpt  = 0;
+			simMounts[i].export = 0;
+			pthread_mutex_unlock(&simMntLock);
+			return 0;
+		}
+	}
+	pthread_mutex_unlock(&simMntLock);
+	errno = ENOENT;
+	return -1;
+}
+
+static int
+isUnder(const char *path, const char *dir, const char **prest)
+{
+size_t l = strlen(dir);
+	while ( l > 1 && '/' == dir[l-1] )
+		l--;
+	if ( strncmp(path, dir, l) || (path[l] && '/' != path[l]) )
+		return 0;
+	*prest = path + l;
+	return 1;
+}
+
+const char *
+simMapPath(const char *path, char *buf, const char **pop)
+{
+char       abs[PATH_MAX];
+const char *rest, *e;
+int        i;
+
+	*pop = 0;
+
+	if ( '/' != *path ) {
+		snprintf(abs, sizeof(abs), "%s%s%s", simCwd, '/' == simCwd[strlen(simCwd)-1] ? "" : "/", path);
+		path = abs;
+	}
+
+	if ( 0 == strncmp(path, "/TFTP/", 6) ) {
+		/* host part is ignored; all servers share one tree */
+		if ( !(rest = strchr(path + 6, '/')) )
+			rest = "";
+		snprintf(buf, PATH_MAX, "%s/tftp%s", simRoot, rest);
+		*pop = "tftp";
+		return buf;
+	}
+
+	pthread_mutex_lock(&simMntLock);
+	for ( i = 0; i < SIM_MAX_MOUNTS; i++ ) {
+		if ( simMounts[i].mntpt && isUnder(path, simMounts[i].mntpt, &rest) ) {
+			for ( e = simMounts[i].export; '/' == *e; e++ )
+				;
+			snprintf(buf, PATH_MAX, "%s/nfs/%s%s", simRoot, e, rest);
+			pthread_mutex_unlock(&simMntLock);
+			*pop = "nfs";
+			return buf;
+		}
+	}
+	pthread_mutex_unlock(&simMntLock);
+
+	snprintf(buf, PATH_MAX, "%s/local%s", simRoot, path);
+	return buf;
+}
+
+int
+__wrap_open(const char *path, int flags, ...)
+{
+char       buf[PATH_MAX];
+const char *op;
+mode_t     mode = 0;
+va_list    ap;
+
+	if ( (O_CREAT & flags) ) {
+		va_start(ap, flags);
+		mode = va_arg(ap, int);
+		va_end(ap);
+	}
+	path = simMapPath(path, buf, &op);
+	if ( op && simOp(op) ) {
+		errno = EIO;
+		return -1;
+	}
+	return __real_open(path, flags, mode);
+}
+
+int
+__wrap_chdir(const char *path)
+{
+char        abs[PATH_MAX], buf[PATH_MAX], *p;
+const char  *op;
+struct stat st;
+
+	if ( '/' != *path )
+		snprintf(abs, sizeof(abs), "%s%s%s", simCwd, '/' == simCwd[strlen(simCwd)-1] ? "" : "/", path);
+	else
+		snprintf(abs, sizeof(abs), "%s", path);
+
+	if ( stat(simMapPath(abs, buf, &op), &st) || !S_ISDIR(st.st_mode) ) {
+		errno = ENOENT;
+		return -1;
+	}
+	/* strip trailing slashes (but keep "/") */
+	for ( p = abs + strlen(abs) - 1; p > abs && '/' == *p; p-- )
+		*p = 0;
+	strcpy(simCwd, abs);
+	return 0;
+}
+
+int
+__wrap_mkdir(const char *path, mode_t mode)
+{
+char       buf[PATH_MAX];
+const char *op;
+	return __real_mkdir(simMapPath(path, buf, &op), mode);
+}
+
+int
+__wrap_unlink(const char *path)
+{
+char       buf[PATH_MAX];
+const char *op;
+	return __real_unlink(simMapPath(path, buf, &op));
+}
+
+/* Init() prompts for a symbol file if the first attempt failed;
+ * end the simulation rather than spinning on EOF.
+ */
+int
+__wrap_getchar()
+{
+int ch;
+	if ( EOF == (ch = __real_getchar()) )
+		simFinish("end of input at prompt");
+	return ch;
+}
+
+void
+simFinish(const char *why)
+{
+int i;
+	fflush(stdout);
+	printf("\nSIM: finished (%s)\n", why);
+	for ( i = 0; i < nSimOps; i++ ) {
+		printf("SIM: %-8s %4u calls, %4u failed\n", simOps[i].name, simOps[i].calls, simOps[i].failed);
+	}
+	gesysBootTimes();
+	if ( getenv("SIM_BOOTDUMP") )
+		gesysBootTimesDump(getenv("SIM_BOOTDUMP"));
+	fflush(stdout);
+	exit(0);
+}
+
+int
+main(int argc, char **argv)
+{
+char buf[PATH_MAX];
+
+	/* keep stdout and stderr in order */
+	setvbuf(stdout, 0, _IONBF, 0);
+
+	if ( getenv("SIM_ROOT") )
+		simRoot = getenv("SIM_ROOT");
+	snprintf(buf, sizeof(buf), "%s/local", simRoot);
+	__real_mkdir(buf, 0777);
+	/* init.c's stat() of /tmp is not mapped */
+	snprintf(buf, sizeof(buf), "%s/local/tmp", simRoot);
+	__real_mkdir(buf, 0777);
+
+	simRtemsInit();
+	simFailInit();
+	simNetInit();
+
+	Init(0);
+	return 1;
+}
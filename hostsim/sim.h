@@ -0,0 +1,48 @@
+/* Host simulation: internal interfaces */
+#ifndef GESYS_HOSTSIM_SIM_H
+#define GESYS_HOSTSIM_SIM_H
+
+/* Delay the calling thread by the latency configured for
+ * operation 'op' (SIM_<OP>_MS) and then decide if the operation
+ * fails (SIM_FAIL).
+ *
+ * RETURNS: 0 if the operation is to succeed, -1 if it fails.
+ */
+int
+simOp(const char *op);
+
+/* Map a simulated remote path (TFTP or below an NFS mount point)
+ * to a host path; 'buf' must hold PATH_MAX bytes.
+ *
+ * RETURNS: mapped path (in 'buf'), 'path' itself if it is local or
+ *          NULL if it refers to an unavailable remote filesystem.
+ *          '*pop' is set to the operation ("tftp", "nfs") for
+ *          simOp() or NULL for local paths.
+ */
+const char *
+simMapPath(const char *path, char *buf, const char **pop);
+
+/* Register / remove an NFS mount (simnet.c) */
+int
+simMountAdd(const char *mntpt, const char *export);
+
+int
+simMountDel(const char *mntpt);
+
+/* Read and discard a file (simcexp.c)
+ *
+ * RETURNS: size or -1 on error.
+ */
+long
+simSlurp(const char *path);
+
+/* End the simulation (prints the boot timeline) */
+void
+simFinish(const char *why);
+
+void
+simRtemsInit(void);
+
+extern const char *simRoot;
+
+#endif
@@ -0,0 +1,203 @@
+/* Host simulation: Cexp and the GeSys helpers init.c calls
+ *
+ * cexp_main() reads the symbol file (if any) and the script;
+ * every 'ld("<file>")' or 'cexpModuleLoad("<file>")' in the script
+ * calls cexpModuleLoad() (simld.c). Other script lines are ignored.
+ * Entering the interactive shell ends the simulation.
+ *
+ * A built-in symbol table is simulated if SIM_BUILTIN_SYMTAB is
+ * set.
+ */
+#include <rtems.h>
+#include <rtems/rtems_bsdnet.h>
+#include <cexp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "sim.h"
+
+void *cexpSystemSymbols = 0;
+
+static char simSysSyms;
+static int  simSymsLoaded = 0;
+
+long
+simSlurp(const char *path)
+{
+char buf[4096];
+int  fd, n;
+long len = 0;
+
+	if ( (fd = open(path, O_RDONLY)) < 0 )
+		return -1;
+	while ( (n = read(fd, buf, sizeof(buf))) > 0 )
+		len += n;
+	close(fd);
+	return len;
+}
+
+int
+cexpInit(void *excHandlerInstall)
+{
+	if ( getenv("SIM_BUILTIN_SYMTAB") )
+		cexpSystemSymbols = &simSysSyms;
+	return 0;
+}
+
+/* execute the module loads listed in a script */
+static int
+simScript(const char *path)
+{
+FILE *f;
+char line[512], *p, *e;
+int  fd;
+
+	if ( (fd = open(path, O_RDONLY)) < 0 || !(f = fdopen(fd, "r")) ) {
+		fprintf(stderr,"SIM: unable to open script '%s'\n", path);
+		if ( fd >= 0 )
+			close(fd);
+		return CEXP_MAIN_NO_SCRIPT;
+	}
+	printf("SIM: executing script '%s'\n", path);
+	while ( fgets(line, sizeof(line), f) ) {
+		if ( '#' == line[0] )
+			continue;
+		if ( !(p = strstr(line, "ld(\"")) && !(p = strstr(line, "cexpModuleLoad(\"")) )
+			continue;
+		p = strchr(p, '"') + 1;
+		if ( !(e = strchr(p, '"')) )
+			continue;
+		*e = 0;
+		cexpModuleLoad(p, 0);
+	}
+	fclose(f);
+	return 0;
+}
+
+int
+cexp_main(int argc, char **argv)
+{
+char *symf = 0, *script = 0;
+int  i;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( !strcmp(argv[i], "-s") && i + 1 < argc )
+			symf = argv[++i];
+		else if ( !strcmp(argv[i], "-a") && i + 1 < argc )
+			i++;
+		else
+			script = argv[i];
+	}
+
+	if ( symf ) {
+		long len;
+		if ( (len = simSlurp(symf)) < 0 ) {
+			fprintf(stderr,"SIM: unable to read symbol file '%s'\n", symf);
+			return CEXP_MAIN_NO_SYMS;
+		}
+		printf("SIM: read symbol file '%s' (%ld bytes)\n", symf, len);
+		simSymsLoaded = 1;
+	} else if ( !cexpSystemSymbols && !simSymsLoaded ) {
+		return CEXP_MAIN_NO_SYMS;
+	}
+
+	if ( script )
+		return simScript(script);
+
+	simFinish("interactive shell reached");
+	return CEXP_MAIN_KILLED;
+}
+
+/* GeSys helpers which are not simulated */
+
+void
+pathSubstituteRefresh()
+{
+}
+
+void
+symCacheAttachFromEnv()
+{
+}
+
+int
+symCacheAttached()
+{
+	return 0;
+}
+
+int
+symCacheGet(const char *key, int fd, char **pFnam)
+{
+	return -1;
+}
+
+/* memFiles are plain (local) files */
+void *
+memFileAlloc(size_t len)
+{
+	return malloc(len);
+}
+
+void *
+memFileRealloc(void *data, size_t len)
+{
+	return realloc(data, len);
+}
+
+void
+memFileFree(void *data)
+{
+	free(data);
+}
+
+int
+memFileCreate(const char *path, void *data, size_t len, int owned)
+{
+int fd, rval = -1;
+	if ( (fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0444)) >= 0 ) {
+		if ( write(fd, data, len) == (ssize_t)len )
+			rval = 0;
+		close(fd);
+	}
+	if ( 0 == rval && owned )
+		free(data);
+	return rval;
+}
+
+int
+memFileRelease(const char *path)
+{
+	return unlink(path);
+}
+
+int
+gesysTarfsLoad(const char *mntpt, void *img, unsigned long len)
+{
+	return -1;
+}
+
+int
+gesys_set_netdriver(const char *name, int (*attach)(struct rtems_bsdnet_ifconfig *, int))
+{
+	return 0;
+}
+
+void
+gesys_set_mbuf_space(unsigned long mbufs, unsigned long clusters)
+{
+}
+
+/* split 'name=value' pairs separated by white space */
+int
+cmdlinePairExtract(char *buf, int (*putpair)(char *str), int removeFound)
+{
+char *tok, *sav;
+	for ( tok = strtok_r(buf, " \t", &sav); tok; tok = strtok_r(0, " \t", &sav) ) {
+		if ( strchr(tok, '=') )
+			putpair(strdup(tok));
+	}
+	return 0;
+}
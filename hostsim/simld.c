@@ -0,0 +1,23 @@
+/* Host simulation: cexpModuleLoad()
+ *
+ * Reads <file> (relative to the current directory, e.g., on TFTP
+ * or NFS) and costs SIM_LOAD_MS on top of the file system latency.
+ * This lives in a file of its own so that calls from simcexp.c
+ * go through a --wrap'ed cexpModuleLoad (prefetch.c).
+ */
+#include <stdio.h>
+
+#include "sim.h"
+
+void *
+cexpModuleLoad(char *file, char *name)
+{
+long len;
+	if ( simOp("load") || (len = simSlurp(file)) < 0 ) {
+		fprintf(stderr,"SIM: loading module '%s' failed\n", file);
+		return 0;
+	}
+	printf("SIM: loaded module '%s'%s%s%s (%ld bytes)\n", file,
+		name ? " as '" : "", name ? name : "", name ? "'" : "", len);
+	return file;
+}
@@ -0,0 +1,101 @@
+/* Host simulation: network bring-up, BOOTP results and NFS client
+ *
+ * BOOTP results come from SIM_BOOTFILE (boot file name),
+ * SIM_CMDLINE (command line; 'name=value' pairs), SIM_SERVER
+ * (server address) and SIM_NTP (nonzero: an NTP server is
+ * configured). SIM_NONET disables the network interface.
+ */
+#include <rtems.h>
+#include <rtems/rtems_bsdnet.h>
+#include <librtemsNfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "sim.h"
+
+static struct rtems_bsdnet_ifconfig simIf = {
+	"sim1", 0, 0
+};
+
+struct rtems_bsdnet_config rtems_bsdnet_config = {
+	&simIf,
+	0,
+	100,
+	180*1024,
+	350*1024,
+};
+
+struct in_addr rtems_bsdnet_bootp_server_address;
+char          *rtems_bsdnet_bootp_boot_file_name = 0;
+char          *rtems_bsdnet_bootp_cmdline        = 0;
+int            rtems_bsdnet_ntpserver_count      = 0;
+
+void
+simNetInit()
+{
+	if ( getenv("SIM_NONET") )
+		rtems_bsdnet_config.ifconfig = 0;
+	inet_aton(getenv("SIM_SERVER") ? getenv("SIM_SERVER") : "127.0.0.1",
+		&rtems_bsdnet_bootp_server_address);
+}
+
+int
+rtems_bsdnet_initialize_network()
+{
+	if ( simOp("netif") )
+		return -1;
+	/* BOOTP reply */
+	if ( getenv("SIM_BOOTFILE") )
+		rtems_bsdnet_bootp_boot_file_name = strdup(getenv("SIM_BOOTFILE"));
+	if ( getenv("SIM_CMDLINE") )
+		rtems_bsdnet_bootp_cmdline = strdup(getenv("SIM_CMDLINE"));
+	if ( getenv("SIM_NTP") && atoi(getenv("SIM_NTP")) )
+		rtems_bsdnet_ntpserver_count = 1;
+	return 0;
+}
+
+int
+rtems_bsdnet_synchronize_ntp(int interval, rtems_task_priority prio)
+{
+	return simOp("ntp");
+}
+
+int
+rpcUdpInit()
+{
+	return simOp("rpc");
+}
+
+/* set by a successful nfsInit(); mounts fail without it */
+static int simNfsUp = 0;
+
+int
+nfsInit(int smallPoolDepth, int bigPoolDepth)
+{
+	if ( simOp("nfsinit") )
+		return -1;
+	simNfsUp = 1;
+	return 0;
+}
+
+/* 'uidhost' is [uid.gid@]host; the host is ignored */
+int
+nfsMount(char *uidhost, char *path, char *mntpoint)
+{
+	printf("SIM: mounting '%s:%s' on '%s'\n", uidhost ? uidhost : "", path, mntpoint);
+	if ( !simNfsUp ) {
+		fprintf(stderr,"SIM: NFS not initialized; mount fails\n");
+		return -1;
+	}
+	if ( simOp("mount") )
+		return -1;
+	return simMountAdd(mntpoint, path);
+}
+
+int
+unmount(const char *mntpoint)
+{
+	return simMountDel(mntpoint);
+}
@@ -0,0 +1,313 @@
+/* Host simulation: RTEMS tasks, semaphores and clock on top of pthreads
+ *
+ * Only what init.c and boottime.c use. Task priorities and modes
+ * are ignored; one global mutex stands in for disabling interrupts.
+ * 'Ticks' are milliseconds since the simulation started.
+ */
+#include <rtems.h>
+#include <rtems/libio.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SIM_MAX_TASKS	32
+#define SIM_MAX_SEMAS	32
+
+typedef struct SimTaskRec_ {
+	int                 used, started;
+	rtems_name          name;
+	pthread_t           thread;
+	rtems_task_entry    entry;
+	rtems_task_argument arg;
+} SimTaskRec, *SimTask;
+
+typedef struct SimSemaRec_ {
+	int                 used;
+	rtems_name          name;
+	unsigned long       count;
+	pthread_cond_t      cond;
+} SimSemaRec, *SimSema;
+
+static SimTaskRec      simTasks[SIM_MAX_TASKS];
+static SimSemaRec      simSemas[SIM_MAX_SEMAS];
+static pthread_mutex_t simLock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t simIrq     = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec simT0;
+
+extern void simFinish(const char *why);
+
+/* ids are 1-based indices; 0 is RTEMS_SELF */
+#define TASK(id)	( (id) > 0 && (id) <= SIM_MAX_TASKS && simTasks[(id)-1].used ? &simTasks[(id)-1] : 0 )
+#define SEMA(id)	( (id) > 0 && (id) <= SIM_MAX_SEMAS && simSemas[(id)-1].used ? &simSemas[(id)-1] : 0 )
+
+void
+simRtemsInit()
+{
+	clock_gettime(CLOCK_MONOTONIC, &simT0);
+}
+
+void
+simIrqLock()
+{
+	pthread_mutex_lock(&simIrq);
+}
+
+void
+simIrqUnlock()
+{
+	pthread_mutex_unlock(&simIrq);
+}
+
+static void *
+simTaskWrapper(void *arg)
+{
+SimTask t = arg;
+	t->entry(t->arg);
+	return 0;
+}
+
+rtems_status_code
+rtems_task_create(rtems_name name, rtems_task_priority prio, size_t stack, rtems_mode modes, rtems_attribute attrs, rtems_id *pid)
+{
+int i;
+	pthread_mutex_lock(&simLock);
+	for ( i = 0; i < SIM_MAX_TASKS; i++ ) {
+		if ( !simTasks[i].used ) {
+			memset(&simTasks[i], 0, sizeof(simTasks[i]));
+			simTasks[i].used = 1;
+			simTasks[i].name = name;
+			*pid = i + 1;
+			pthread_mutex_unlock(&simLock);
+			return RTEMS_SUCCESSFUL;
+		}
+	}
+	pthread_mutex_unlock(&simLock);
+	return RTEMS_TOO_MANY;
+}
+
+rtems_status_code
+rtems_task_start(rtems_id id, rtems_task_entry entry, rtems_task_argument arg)
+{
+SimTask        t;
+pthread_attr_t a;
+int            err;
+
+	if ( !(t = TASK(id)) )
+		return RTEMS_INVALID_ID;
+	if ( t->started )
+		return RTEMS_INCORRECT_STATE;
+	t->entry   = entry;
+	t->arg     = arg;
+	t->started = 1;
+	pthread_attr_init(&a);
+	pthread_attr_setdetachstate(&a, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&t->thread, &a, simTaskWrapper, t);
+	pthread_attr_destroy(&a);
+	if ( err ) {
+		t->started = 0;
+		return RTEMS_TOO_MANY;
+	}
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_delete(rtems_id id)
+{
+SimTask t;
+int     i;
+
+	if ( RTEMS_SELF == id ) {
+		pthread_mutex_lock(&simLock);
+		for ( i = 0; i < SIM_MAX_TASKS; i++ ) {
+			if ( simTasks[i].used && simTasks[i].started && pthread_equal(simTasks[i].thread, pthread_self()) )
+				simTasks[i].used = 0;
+		}
+		pthread_mutex_unlock(&simLock);
+		pthread_exit(0);
+	}
+	if ( !(t = TASK(id)) )
+		return RTEMS_INVALID_ID;
+	if ( t->started )
+		return RTEMS_INCORRECT_STATE;	/* cannot kill a running thread */
+	t->used = 0;
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_suspend(rtems_id id)
+{
+	if ( RTEMS_SELF == id )
+		simFinish("initialization task suspended itself");
+	return RTEMS_INCORRECT_STATE;
+}
+
+rtems_status_code
+rtems_task_set_priority(rtems_id id, rtems_task_priority prio, rtems_task_priority *pold)
+{
+	if ( pold )
+		*pold = 100;
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_wake_after(rtems_interval ticks)
+{
+	usleep( (useconds_t)ticks * 1000 );
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_semaphore_create(rtems_name name, uint32_t count, rtems_attribute attrs, rtems_task_priority ceiling, rtems_id *pid)
+{
+int i;
+	pthread_mutex_lock(&simLock);
+	for ( i = 0; i < SIM_MAX_SEMAS; i++ ) {
+		if ( !simSemas[i].used ) {
+			simSemas[i].used  = 1;
+			simSemas[i].name  = name;
+			simSemas[i].count = count;
+			pthread_cond_init(&simSemas[i].cond, 0);
+			*pid = i + 1;
+			pthread_mutex_unlock(&simLock);
+			return RTEMS_SUCCESSFUL;
+		}
+	}
+	pthread_mutex_unlock(&simLock);
+	return RTEMS_TOO_MANY;
+}
+
+rtems_status_code
+rtems_semaphore_obtain(rtems_id id, uint32_t opts, rtems_interval timeout)
+{
+SimSema           s;
+struct timespec   abst;
+rtems_status_code rval = RTEMS_SUCCESSFUL;
+
+	pthread_mutex_lock(&simLock);
+	if ( !(s = SEMA(id)) ) {
+		pthread_mutex_unlock(&simLock);
+		return RTEMS_INVALID_ID;
+	}
+	if ( timeout ) {
+		clock_gettime(CLOCK_REALTIME, &abst);
+		abst.tv_sec  += timeout / 1000;
+		abst.tv_nsec += (timeout % 1000) * 1000000L;
+		if ( abst.tv_nsec >= 1000000000L ) {
+			abst.tv_sec++;
+			abst.tv_nsec -= 1000000000L;
+		}
+	}
+	while ( 0 == s->count ) {
+		if ( RTEMS_NO_WAIT & opts ) {
+			rval = RTEMS_UNSATISFIED;
+			break;
+		}
+		if ( timeout ) {
+			if ( ETIMEDOUT == pthread_cond_timedwait(&s->cond, &simLock, &abst) ) {
+				rval = RTEMS_UNSATISFIED;
+				break;
+			}
+		} else {
+			pthread_cond_wait(&s->cond, &simLock);
+		}
+	}
+	if ( RTEMS_SUCCESSFUL == rval )
+		s->count--;
+	pthread_mutex_unlock(&simLock);
+	return rval;
+}
+
+rtems_status_code
+rtems_semaphore_release(rtems_id id)
+{
+SimSema s;
+	pthread_mutex_lock(&simLock);
+	if ( !(s = SEMA(id)) ) {
+		pthread_mutex_unlock(&simLock);
+		return RTEMS_INVALID_ID;
+	}
+	s->count++;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&simLock);
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_semaphore_delete(rtems_id id)
+{
+SimSema s;
+	pthread_mutex_lock(&simLock);
+	if ( !(s = SEMA(id)) ) {
+		pthread_mutex_unlock(&simLock);
+		return RTEMS_INVALID_ID;
+	}
+	pthread_cond_destroy(&s->cond);
+	s->used = 0;
+	pthread_mutex_unlock(&simLock);
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_clock_get_uptime(struct timespec *pt)
+{
+struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pt->tv_sec  = now.tv_sec  - simT0.tv_sec;
+	pt->tv_nsec = now.tv_nsec - simT0.tv_nsec;
+	if ( pt->tv_nsec < 0 ) {
+		pt->tv_sec--;
+		pt->tv_nsec += 1000000000L;
+	}
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_clock_get(rtems_clock_get_options opt, void *p)
+{
+struct timespec up;
+
+	switch ( opt ) {
+		case RTEMS_CLOCK_GET_TICKS_PER_SECOND:
+			*(rtems_interval*)p = 1000;
+		break;
+
+		case RTEMS_CLOCK_GET_TICKS_SINCE_BOOT:
+			rtems_clock_get_uptime(&up);
+			*(rtems_interval*)p = up.tv_sec * 1000 + up.tv_nsec / 1000000;
+		break;
+
+		default:
+			/* TOD is never set; init.c falls back to its default */
+			return RTEMS_NOT_DEFINED;
+	}
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_clock_set(rtems_time_of_day *tod)
+{
+	return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_libio_set_private_env()
+{
+	return RTEMS_SUCCESSFUL;
+}
+
+const char *
+rtems_status_text(rtems_status_code sc)
+{
+	switch ( sc ) {
+		case RTEMS_SUCCESSFUL:      return "successful completion";
+		case RTEMS_TOO_MANY:        return "too many";
+		case RTEMS_INVALID_ID:      return "invalid id";
+		case RTEMS_NOT_DEFINED:     return "not defined";
+		case RTEMS_UNSATISFIED:     return "unsatisfied";
+		case RTEMS_INCORRECT_STATE: return "incorrect state";
+		default:                    break;
+	}
+	return "internal error";
+}
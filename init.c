@@ -248,6 +248,69 @@ cmdlinePairExtract(char *buf, int (*putpair)(char *str), int removeFound);
 int
 getchar_timeout(int fd, int timeout);
 
+void
+gesysBootMark(const char *stage);
+
+int
+gesysTarfsLoad(const char *mntpt, void *img, unsigned long len);
+
+void
+pathSubstituteRefresh();
+
+int
+symCacheAttachFromEnv();
+
+int
+symCacheAttached();
+
+int
+symCacheGet(const char *key, int fd, char **pFnam);
+
+int
+memFileRelease(const char *path);
+
+void *
+memFileRealloc(void *data, size_t len);
+
+void
+memFileFree(void *data);
+
+int
+memFileCreate(const char *path, void *data, size_t len, int owned);
+
+#ifdef NFS_SUPPORT
+int
+mntTabAdd(const char *uidhost, const char *rpath, const char *mntpt, unsigned long ms_taken);
+
+int
+mntTabForget(const char *mntpt);
+
+void *
+mntTabMountAsync(const char *uidhost, const char *rpath, const char *mntpt);
+
+int
+mntTabWait(void *h, const char *rpath, char **pdir);
+
+int
+mntTabRelease(void *h);
+#endif
+
+#ifdef MODULE_PREFETCH
+int
+gesysPrefetchScript(const char *dir, const char *script);
+
+void
+gesysPrefetchFlush();
+#endif
+
+#ifdef RSH_SUPPORT
+int
+rshXfer(int fd, int ed, char **pData, size_t *pLen, size_t *pCap);
+
+void
+rshXferStats();
+#endif
+
 static void
 dummy_clock_init();
 
@@ -256,6 +319,20 @@ static void freeps(char **ps)
 	free(*ps); *ps = 0;
 }
 
+/* Replace '*pPath' by a cached copy of the file open on 'fd'
+ * (see symcache.c); '*pPath' is left alone if the cache cannot
+ * be used.
+ */
+static void
+symCacheSubst(const char *key, int fd, char **pPath)
+{
+char *cached = 0;
+	if ( symCacheGet(key, fd, &cached) >= 0 ) {
+		freeps(pPath);
+		*pPath = cached;
+	}
+}
+
 static char *theSrv = 0;
 
 #define DFLT_SRV_LEN 100
@@ -285,6 +362,79 @@ struct stat stbuf;
     }
 }
 
+#ifdef NFS_SUPPORT
+/* Mount for the user (INIT) script; it is requested before the
+ * system script executes so that the mount overlaps it (see mnttab.c).
+ */
+static struct {
+	char *spec;		/* INIT pathspec the mount was requested for */
+	char *script;	/* script path below homemnt.mntpt           */
+	void *mnt;		/* mount table handle                        */
+} initMnt = { 0, 0, 0 };
+
+static void initMountStart(char **pDfltSrv, char *spec, MntDesc homemnt)
+{
+char *tmp;
+
+	if ( initMnt.spec || !spec || NFS_PATH != pathType(spec) )
+		return;
+
+	if ( !(initMnt.spec = strdup(spec)) || !(tmp = strdup(spec)) )
+		return;
+
+	getDfltSrv(pDfltSrv);
+
+	if ( 0 == isNfsPath( pDfltSrv, tmp, 0, &initMnt.script, homemnt ) )
+		initMnt.mnt = mntTabMountAsync(homemnt->uidhost, homemnt->rpath, homemnt->mntpt);
+
+	free(tmp);
+}
+
+static void initMountRelease(MntDesc homemnt)
+{
+	mntTabRelease(initMnt.mnt);
+	initMnt.mnt = 0;
+	freeps(&initMnt.spec);
+	freeps(&initMnt.script);
+	/* the mount table owns the mount; just forget the export */
+	freeps(&homemnt->uidhost);
+	freeps(&homemnt->rpath);
+}
+
+/* Wait for the INIT script's mount (requesting it now if that was
+ * not done early or INIT changed meanwhile) and return the script's
+ * path in *pscript; this is below /boot if the boot mount serves
+ * the script's export.
+ *
+ * RETURNS: 0 on success, nonzero on error.
+ */
+static int initMountWait(char **pDfltSrv, char *spec, MntDesc homemnt, char **pscript)
+{
+char *dir = 0;
+int  l;
+
+	if ( initMnt.spec && strcmp(initMnt.spec, spec) )
+		initMountRelease(homemnt);
+
+	initMountStart(pDfltSrv, spec, homemnt);
+
+	if ( !initMnt.script )
+		return -1;
+
+	if ( !initMnt.mnt || mntTabWait(initMnt.mnt, homemnt->rpath, &dir) )
+		return -1;
+
+	l = strlen(homemnt->mntpt);
+	if ( !(*pscript = malloc(strlen(dir) + strlen(initMnt.script + l) + 1)) ) {
+		free(dir);
+		return -1;
+	}
+	strcat(strcpy(*pscript, dir), initMnt.script + l);
+	free(dir);
+	return 0;
+}
+#endif
+
 #ifdef RPCIO_HAS_SEED_XID_UPPER
 static uint32_t dumb_hash(uint32_t n)
 {
@@ -301,10 +451,90 @@ uint64_t r = (uint64_t)n;
 }
 #endif
 
-int
-gesys_network_start()
+/* Network bring-up is split into stages. Stages which do not
+ * depend on each other (e.g., NTP synchronization and stuffing
+ * the command line into the environment) are executed by
+ * separate tasks concurrently. Each stage lists the stages it
+ * depends upon and waits for their completion before it
+ * proceeds.
+ * gesys_network_join() waits for all stages to complete and
+ * reports the individual results.
+ */
+
+#define NS_OK		0
+#define NS_FAILED	(-1)
+#define NS_SKIPPED	1
+
+typedef struct NetStageRec_ {
+	const char     *name;
+	int           (*fn)(void);
+	unsigned        deps;     /* mask of stages that must be done first */
+	int             result;
+	rtems_id        gate;     /* available once the stage is done       */
+	rtems_interval  t_start, t_end;
+} NetStageRec, *NetStage;
+
+enum {
+	NS_NTP = 0,
+	NS_PING,
+	NS_RPC,
+	NS_NFS,
+	NS_CMDLINE,
+	NS_NUM_STAGES
+};
+
+#define NS_BIT(s)	(1<<(s))
+
+static int ns_ntp(void);
+static int ns_ping(void);
+static int ns_rpc(void);
+static int ns_nfs(void);
+static int ns_cmdline(void);
+
+/* NOTE: stages must be listed in an order compatible
+ *       with their dependencies (in case we have to
+ *       fall back to executing them sequentially).
+ */
+static NetStageRec netStages[NS_NUM_STAGES] = {
+	[NS_NTP]     = { "ntp",     ns_ntp,     0 },
+	[NS_PING]    = { "ping",    ns_ping,    0 },
+#ifdef RPCIO_HAS_SEED_XID_UPPER
+	/* XID seed is derived from NTP time and ping delay */
+	[NS_RPC]     = { "rpc",     ns_rpc,     NS_BIT(NS_NTP) | NS_BIT(NS_PING) },
+#else
+	[NS_RPC]     = { "rpc",     ns_rpc,     0 },
+#endif
+	[NS_NFS]     = { "nfs",     ns_nfs,     NS_BIT(NS_RPC) },
+	[NS_CMDLINE] = { "cmdline", ns_cmdline, 0 },
+};
+
+static int netStagesPending = 0;
+
+static int ns_ntp(void)
+{
+	if ( rtems_bsdnet_ntpserver_count <= 0 )
+		return NS_SKIPPED;
+	return rtems_bsdnet_synchronize_ntp(0,0) < 0 ? NS_FAILED : NS_OK;
+}
+
+#if defined(NFS_SUPPORT) && defined(RPCIO_HAS_SEED_XID_UPPER) && defined(HAVE_ICMPPING_H)
+static int pingval = 0;
+#endif
+
+static int ns_ping(void)
+{
+#if defined(NFS_SUPPORT) && defined(RPCIO_HAS_SEED_XID_UPPER) && defined(HAVE_ICMPPING_H)
+  /* If there is a gateway then try to ping it (for obtaining a somewhat random delay) */
+  if ( rtems_bsdnet_config.gateway ) {
+    pingval = rtems_ping( rtems_bsdnet_config.gateway, 0, 1 );
+	return pingval > 0 ? NS_OK : NS_FAILED;
+  }
+#endif
+  return NS_SKIPPED;
+}
+
+static int ns_rpc(void)
 {
-char             *buf;
 #ifdef NFS_SUPPORT
 #ifdef RPCIO_HAS_SEED_XID_UPPER
 uint32_t          seed    = 0;
@@ -312,8 +542,149 @@ struct timespec   now;
 unsigned short    rpcPort = 0;
 #endif
 unsigned          rpcPortAttempts = 3;
+
+#ifdef RPCIO_HAS_SEED_XID_UPPER
+  if (  0 == clock_gettime( CLOCK_REALTIME, &now ) ) {
+    seed  = dumb_hash( now.tv_sec );
+    seed ^= dumb_hash( now.tv_nsec );
+    printf( "RPC XID Seed from NTP: 0x%08" PRIx32 "\n", seed );
+  }
+
+#ifdef HAVE_ICMPPING_H
+  if ( pingval > 0 ) {
+	seed ^= dumb_hash( pingval );
+  }
+#endif
+
+  if ( 0 == seed ) {
+    printf( "WARNING -- random seeding of RPC XID/port FAILED; neither NTP nor PING were available\n" );
+  }
+
+  rpcUdpSeedXidUpper( seed );
+
+  rpcPort = seed;
+
+  do {
+    rpcPort = 512 + ( ( dumb_hash( rpcPort ) >> 15 ) & 0x1ff );
+  } while ( rpcUdpInitOnPort( rpcPort ) && ( --rpcPortAttempts > 0 ) );
+#else
+  if ( rpcUdpInit() ) {
+    rpcPortAttempts = 0;
+  }
 #endif
 
+  if ( rpcPortAttempts > 0 ) {
+#ifdef RPCIO_HAS_SEED_XID_UPPER
+    printf( "RPCIO Initialization successful; used port %hu, XID seed 0x%08" PRIx32 "\n", rpcPort, seed );
+#endif
+	return NS_OK;
+  }
+  printf( "WARNING -- RPCIO Initialization FAILED -- NFS not available\n" );
+  return NS_FAILED;
+#else
+  return NS_SKIPPED;
+#endif
+}
+
+static int ns_nfs(void)
+{
+#ifdef NFS_SUPPORT
+  if ( NS_OK != netStages[NS_RPC].result )
+	return NS_SKIPPED;
+  if ( nfsInit( 0, 0 ) ) {
+    printf( "WARNING -- NFS initialization FAILED\n" );
+	return NS_FAILED;
+  }
+  return NS_OK;
+#else
+  return NS_SKIPPED;
+#endif
+}
+
+static int ns_cmdline(void)
+{
+char *buf;
+  /* stuff command line 'name=value' pairs into the environment */
+  if ( rtems_bsdnet_bootp_cmdline && (buf = strdup(rtems_bsdnet_bootp_cmdline)) ) {
+	cmdlinePairExtract(buf, putenv, 1);
+	free(buf);
+	return NS_OK;
+  }
+  return NS_SKIPPED;
+}
+
+static void netStageWait(NetStage s)
+{
+	/* gate semaphore is released (and stays available) once
+	 * the stage is done; pass the token on to other waiters.
+	 */
+	rtems_semaphore_obtain(s->gate, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+	rtems_semaphore_release(s->gate);
+}
+
+static void netStageRun(NetStage s)
+{
+int i;
+	for ( i=0; i<NS_NUM_STAGES; i++ ) {
+		if ( (s->deps & NS_BIT(i)) )
+			netStageWait( &netStages[i] );
+	}
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &s->t_start );
+	s->result = s->fn();
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &s->t_end );
+	gesysBootMark(s->name);
+	rtems_semaphore_release( s->gate );
+}
+
+static rtems_task netStageTask(rtems_task_argument arg)
+{
+	netStageRun( &netStages[arg] );
+	rtems_task_delete( RTEMS_SELF );
+}
+
+/* Read a size (bytes; a 'k' or 'M' suffix may be appended)
+ * from an environment variable; RETURNS 0 if undefined or
+ * invalid (a message is printed in the latter case).
+ */
+static unsigned long
+envBytes(const char *var)
+{
+char          *str, *end;
+unsigned long rval;
+	if ( !(str = getenv(var)) )
+		return 0;
+	rval = strtoul(str, &end, 0);
+	if ( 'k' == *end || 'K' == *end ) {
+		rval <<= 10;
+		end++;
+	} else if ( 'M' == *end || 'm' == *end ) {
+		rval <<= 20;
+		end++;
+	}
+	if ( end == str || *end ) {
+		fprintf(stderr,"%s: invalid size '%s' (expected <number>[k|M]); ignored\n", var, str);
+		return 0;
+	}
+	return rval;
+}
+
+/* Initialize networking and launch the remaining bring-up
+ * stages; returns without waiting for them to complete
+ * (use gesys_network_join()).
+ */
+int
+gesys_network_start_async()
+{
+rtems_task_priority prio;
+rtems_status_code   sc;
+rtems_id            tid;
+int                 i;
+
+  if ( netStagesPending ) {
+	fprintf(stderr,"gesys_network_start(): already started\n");
+	return -1;
+  }
+
 #ifdef MULTI_NETDRIVER
   printf("Going to probe for Ethernet chips when initializing networking:\n");
   printf("(supported are 3c509 (ISA), 3c90x (PCI) and eepro100 (PCI) variants).\n");
@@ -340,7 +711,21 @@ unsigned          rpcPortAttempts = 3;
   	}
   }
 
+  {
+  extern void gesys_set_mbuf_space(unsigned long, unsigned long);
+  unsigned long mbufs    = envBytes("NET_MBUF_SPACE");
+  unsigned long clusters = envBytes("NET_CLUSTER_SPACE");
+
+	if ( mbufs || clusters ) {
+		printf("Network buffers: %lu bytes for mbufs, %lu bytes for clusters\n",
+			mbufs    ? mbufs    : (unsigned long)rtems_bsdnet_config.mbuf_bytecount,
+			clusters ? clusters : (unsigned long)rtems_bsdnet_config.mbuf_cluster_bytecount);
+		gesys_set_mbuf_space(mbufs, clusters);
+	}
+  }
+
   rtems_bsdnet_initialize_network(); 
+  gesysBootMark("netif");
 
   /* remote logging only works after a call to openlog()... */
   openlog(0, LOG_PID | LOG_CONS, 0); /* use RTEMS defaults */
@@ -351,71 +736,97 @@ unsigned          rpcPortAttempts = 3;
 #endif
 
   if ( rtems_bsdnet_ntpserver_count > 0 ) {
-  	printf("Trying to synchronize NTP...");
-  	fflush(stdout);
-  	if ( rtems_bsdnet_synchronize_ntp(0,0) < 0 ) {
-		printf("FAILED\n");
-  	} else {
-		printf("OK\n");
-	}
+	printf("Synchronizing NTP in the background...\n");
   }
 
-#ifdef NFS_SUPPORT
-
-#ifdef RPCIO_HAS_SEED_XID_UPPER
-  if (  0 == clock_gettime( CLOCK_REALTIME, &now ) ) {
-    seed  = dumb_hash( now.tv_sec );
-    seed ^= dumb_hash( now.tv_nsec );
-    printf( "RPC XID Seed from NTP: 0x%08" PRIx32 "\n", seed );
+  for ( i=0; i<NS_NUM_STAGES; i++ ) {
+	sc = rtems_semaphore_create(
+			rtems_build_name('N','S','G','0'+i),
+			0,
+			RTEMS_COUNTING_SEMAPHORE | RTEMS_FIFO,
+			0,
+			&netStages[i].gate );
+	assert( RTEMS_SUCCESSFUL == sc );
   }
 
-#ifdef HAVE_ICMPPING_H
-  /* If there is a gateway then try to ping it (for obtaining a somewhat random delay) */
-  if ( rtems_bsdnet_config.gateway ) {
-    int pingval = rtems_ping( rtems_bsdnet_config.gateway, 0, 1 );
-	if ( pingval > 0 ) {
-		seed ^= dumb_hash( pingval );
+  netStagesPending = 1;
+
+  rtems_task_set_priority( RTEMS_SELF, RTEMS_CURRENT_PRIORITY, &prio );
+
+  for ( i=0; i<NS_NUM_STAGES; i++ ) {
+	sc = rtems_task_create(
+			rtems_build_name('N','S','T','0'+i),
+			prio,
+			4*RTEMS_MINIMUM_STACK_SIZE,
+			RTEMS_DEFAULT_MODES,
+			RTEMS_FLOATING_POINT | RTEMS_LOCAL,
+			&tid );
+	if ( RTEMS_SUCCESSFUL == sc ) {
+		sc = rtems_task_start( tid, netStageTask, i );
+		if ( RTEMS_SUCCESSFUL != sc )
+			rtems_task_delete( tid );
+	}
+	if ( RTEMS_SUCCESSFUL != sc ) {
+		fprintf(stderr,"Unable to spawn task for network stage '%s' (%s); executing sequentially\n",
+			netStages[i].name, rtems_status_text(sc));
+		netStageRun( &netStages[i] );
 	}
-  }
-#endif
-
-  if ( 0 == seed ) {
-    printf( "WARNING -- random seeding of RPC XID/port FAILED; neither NTP nor PING were available\n" );
   }
 
-  rpcUdpSeedXidUpper( seed );
-
-  rpcPort = seed;
+  return 0;
+}
 
-  do {
-    rpcPort = 512 + ( ( dumb_hash( rpcPort ) >> 15 ) & 0x1ff );
-  } while ( rpcUdpInitOnPort( rpcPort ) && ( --rpcPortAttempts > 0 ) );
-#else
-  if ( rpcUdpInit() ) {
-    rpcPortAttempts = 0;
+/* Wait for all network bring-up stages to complete and
+ * report their results.
+ *
+ * RETURNS: 0 if all stages succeeded or were skipped,
+ *          -1 if any stage failed.
+ */
+int
+gesys_network_join()
+{
+rtems_interval tps;
+int            i, rval = 0;
+NetStage       s;
+
+  if ( !netStagesPending )
+	return 0;
+
+  rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+  printf("Network initialization stages:\n");
+  for ( i=0; i<NS_NUM_STAGES; i++ ) {
+	s = &netStages[i];
+	netStageWait( s );
+	printf("  %-8s %-8s (%lu ms)\n",
+		s->name,
+		NS_OK      == s->result ? "OK"      :
+		NS_SKIPPED == s->result ? "SKIPPED" : "FAILED",
+		(unsigned long)(s->t_end - s->t_start) * 1000UL / tps );
+	if ( NS_FAILED == s->result )
+		rval = -1;
   }
-#endif
 
-  if ( rpcPortAttempts > 0 ) {
-#ifdef RPCIO_HAS_SEED_XID_UPPER
-    printf( "RPCIO Initialization successful; used port %hu, XID seed 0x%08" PRIx32 "\n", rpcPort, seed );
-#endif
-    if ( nfsInit( 0, 0 ) ) {
-      printf( "WARNING -- NFS initialization FAILED\n" );
-    }
-  } else {
-    printf( "WARNING -- RPCIO Initialization FAILED -- NFS not available\n" );
+  /* later stages may still signal the gate of an earlier one;
+   * delete the gates only once all stages are done.
+   */
+  for ( i=0; i<NS_NUM_STAGES; i++ ) {
+	rtems_semaphore_delete( netStages[i].gate );
   }
 
-#endif
+  netStagesPending = 0;
 
-  /* stuff command line 'name=value' pairs into the environment */
-  if ( rtems_bsdnet_bootp_cmdline && (buf = strdup(rtems_bsdnet_bootp_cmdline)) ) {
-	cmdlinePairExtract(buf, putenv, 1);
-	free(buf);
-  }
+  return rval;
+}
 
-  return 0;
+/* Initialize networking and wait for all stages to complete */
+int
+gesys_network_start()
+{
+	if ( gesys_network_start_async() )
+		return -1;
+	gesys_network_join();
+	return 0;
 }
 
 extern void *cexpSystemSymbols;
@@ -440,6 +851,9 @@ char	*pathspec = 0;
 MntDescRec	bootmnt = { "/boot", 0, 0 };
 MntDescRec      homemnt = { "/home", 0, 0 };
 #endif
+#ifdef MODULE_PREFETCH
+char	*moddir   = 0;	/* where st.sys loads modules from */
+#endif
 char	*argv[7]={
 	"Cexp",	/* program name */
 	0,
@@ -449,6 +863,8 @@ char	*argv[7]={
 };
 int st;
 
+  gesysBootMark("start");
+
   rtems_libio_set_private_env();
 
 #ifdef HAVE_PCIBIOS
@@ -468,6 +884,7 @@ int st;
 
 #ifdef HAVE_LIBBSPEXT
   bspExtInit();
+  gesysBootMark("bspExtInit");
 #endif
 
   /* make /tmp directory */
@@ -524,6 +941,7 @@ int st;
   dummy_clock_init();
 
   cexpInit(cexpExcHandlerInstall);
+  gesysBootMark("cexpInit");
 
   printf("To skip initialization, press a key now...");
   fflush(stdout);
@@ -533,6 +951,7 @@ int st;
 	argc   = 1;
   }
   printf("\n");
+  gesysBootMark("keywait");
 
 #ifndef CDROM_IMAGE
 #ifndef SKIP_NETINI
@@ -541,7 +960,7 @@ int st;
   /* check if we have a real ifconfig (first is loopback) */
   if ( !no_net && (! (SKIP_NETINI) || !BUILTIN_SYMTAB) && rtems_bsdnet_config.ifconfig )
   {
-    gesys_network_start();
+    gesys_network_start_async();
   }
   else
   {
@@ -586,6 +1005,16 @@ int st;
 		}
 	}
   }
+
+  /* network stages (and the environment) must be complete from here on */
+  gesys_network_join();
+  gesysBootMark("network");
+
+  /* cache hostname, IP address etc. for pathSubstitute() */
+  pathSubstituteRefresh();
+
+  symCacheAttachFromEnv();
+
   {
   char *tarvar;
   void *addr;
@@ -594,7 +1023,7 @@ int st;
 printf("Making '/tar' directory\n");
 		mkdir("/tar",0777);
 printf("Loading tar image @%p[%u]\n", addr, len);
-		if ( (st = rtems_tarfs_load("/tar",addr,len)) )
+		if ( (st = gesysTarfsLoad("/tar",addr,len)) )
 			printf("Loading tar image failed: %i\n", st);
 		else
 			printf("Success\n");
@@ -605,7 +1034,7 @@ printf("Loading tar image @%p[%u]\n", addr, len);
 	extern void *gesys_tarfs_image_start;
 	extern unsigned long gesys_tarfs_image_size;
 	printf("Loading TARFS... %s\n", 
-		rtems_tarfs_load("/tmp", gesys_tarfs_image_start, gesys_tarfs_image_size) ? "FAILED" : "OK");
+		gesysTarfsLoad("/tmp", gesys_tarfs_image_start, gesys_tarfs_image_size) ? "FAILED" : "OK");
 	pathspec=strdup(BUILTIN_SYMTAB ? "/tmp/"SYSSCRIPT : "/tmp/rtems.sym");
   }
 #endif
@@ -650,6 +1079,11 @@ printf("Loading tar image @%p[%u]\n", addr, len);
   do {
 	chdir("/");
 #ifdef NFS_SUPPORT
+	initMountRelease( &homemnt );
+	if ( mntTabForget( bootmnt.mntpt ) > 0 ) {
+		fprintf(stderr,"/boot NFS is still in use - don't know what to do, sorry\n");
+		break;
+	}
 	if ( releaseMount( &bootmnt ) ) {
 		fprintf(stderr,"Unable to unmount /boot NFS - don't know what to do, sorry\n");
 		break;
@@ -695,6 +1129,7 @@ firstTimeEntry:
   {
 	int fd = -1, ed = -1;
 	char *slash;
+	char *cachedSymf = 0, *scrkey = 0;
 
 	getDfltSrv( &dfltSrv );
 
@@ -718,7 +1153,18 @@ firstTimeEntry:
 
 #ifdef NFS_SUPPORT
 		case NFS_PATH:
+			{
+			rtems_interval t0, t1, tps;
+			rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
     		fd = isNfsPath( &dfltSrv, pathspec, &ed, &symf, &bootmnt );
+			rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+			rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+			/* let the INIT script share /boot if it lives on the same export */
+			if ( fd >= 0 ) {
+				mntTabForget( bootmnt.mntpt );
+				mntTabAdd( bootmnt.uidhost, bootmnt.rpath, bootmnt.mntpt, (t1 - t0) * 1000UL / tps );
+			}
+			}
 		break;
 #endif
 
@@ -741,6 +1187,8 @@ firstTimeEntry:
 	}
 
 
+	gesysBootMark("symfile");
+
 	if ( (fd < 0) && !BUILTIN_SYMTAB ) {
 		fprintf(stderr,"Unable to open symbol file (%s)\n", 
 			-11 == fd ? "not a valid pathspec" : strerror(errno));
@@ -748,6 +1196,12 @@ continue;
 	}
 	
 
+	/* transfer the symbol file through the cache (if any) */
+	if ( fd >= 0 && !BUILTIN_SYMTAB && !ISONTMP(symf) ) {
+		if ( symCacheGet(symf, fd, &cachedSymf) < 0 )
+			cachedSymf = 0;
+	}
+
 	if ( fd >= 0 )
 		close(fd);
 	if ( ed >= 0 )
@@ -766,8 +1220,33 @@ continue;
 			if ( chdir(symf) )
 				printf(" FAILED: %s",strerror(errno));
 			fputc('\n',stdout);
+#ifdef MODULE_PREFETCH
+			freeps(&moddir);
+			moddir = strdup(symf);
+#endif
 			*(slash+1)=ch;
 		}
+
+		/* system script is looked up relative to the symbol file;
+		 * don't bother opening it if there is no cache to fill.
+		 */
+		if ( symCacheAttached() && (scrkey = malloc(strlen(symf) + strlen(SYSSCRIPT) + 1)) ) {
+			strcpy(scrkey, symf);
+			if ( (slash = strrchr(scrkey,'/')) )
+				strcpy(slash+1, SYSSCRIPT);
+			else
+				strcpy(scrkey, SYSSCRIPT);
+			if ( (fd = open(sysscr, O_RDONLY)) >= 0 ) {
+				symCacheSubst(scrkey, fd, &sysscr);
+				close(fd);
+			}
+			freeps(&scrkey);
+		}
+
+		if ( cachedSymf ) {
+			freeps(&symf);
+			symf = cachedSymf; cachedSymf = 0;
+		}
 #if defined(RSH_SUPPORT) && !defined(CDROM_IMAGE)
 	} else {
 		char *scrspec = malloc( strlen(pathspec) + strlen(SYSSCRIPT) + 1);
@@ -831,11 +1310,30 @@ shell_entry:
 #endif
 
 
+#ifdef NFS_SUPPORT
+	/* mount the user script's export while the system script executes */
+	initMountStart( &dfltSrv, getenv("INIT"), &homemnt );
+#endif
+
+	gesysBootMark("cexp_main");
+
+#ifdef MODULE_PREFETCH
+	/* transfer the modules st.sys loads while it executes */
+	if ( argc > 1 && sysscr && moddir )
+		gesysPrefetchScript(moddir, sysscr);
+#endif
+
 	result = argc > 1 ? cexp_main(argc, argv) : 0;
 
-	if ( ISONTMP( symf ) )
+#ifdef MODULE_PREFETCH
+	gesysPrefetchFlush();
+#endif
+
+	gesysBootMark("st.sys");
+
+	if ( ISONTMP( symf ) && memFileRelease( symf ) )
 		unlink( symf );
-	if ( ISONTMP( sysscr ) )
+	if ( ISONTMP( sysscr ) && memFileRelease( sysscr ) )
 		unlink( sysscr );
 
 	freeps(&symf);
@@ -863,12 +1361,10 @@ shell_entry:
 			switch ( pathType( pathspec ) ) {
 #ifdef NFS_SUPPORT
 				case NFS_PATH:	 
-					if ( 0 == (rc = isNfsPath( &dfltSrv, pathspec, 0, &user_script, &homemnt ) ) ) {
-						/* valid NFS path; try to mount; */
-						if ( !bootmnt.uidhost || strcmp( homemnt.uidhost, bootmnt.uidhost ) ||
-						     !bootmnt.rpath   || strcmp( homemnt.rpath  , bootmnt.rpath   ) )
-							rc = nfsMount(homemnt.uidhost, homemnt.rpath, homemnt.mntpt);
-					}
+					/* mount was requested before the system script ran
+					 * (or shares an existing mount, e.g., /boot)
+					 */
+					rc = initMountWait( &dfltSrv, pathspec, &homemnt, &user_script );
 				break;
 #endif
 				case RSH_PATH:
@@ -896,6 +1392,8 @@ shell_entry:
 
 			freeps(&pathspec);
 
+			gesysBootMark("init_path");
+
 			argc = 2;
 
 			if ( rc ) {
@@ -911,22 +1409,29 @@ shell_entry:
 					chdir(user_script);
 					*(slash)=ch;
 					argv[1]=slash;
+#ifdef MODULE_PREFETCH
+					gesysPrefetchScript(0, user_script);
+#endif
 				} else {
 					argv[1]=user_script;
 				}
 			}
-			argc=2;
 		} else {
 			argc=1;
 		}
 		do {
 			result=cexp_main(argc,argv);
+			if ( argc > 1 )
+				gesysBootMark("init_script");
 			argc=1;
   			freeps(&user_script);
+#ifdef MODULE_PREFETCH
+			gesysPrefetchFlush();
+#endif
 		} while (!result || CEXP_MAIN_NO_SCRIPT==result);
 		chdir("/");
 #ifdef NFS_SUPPORT
-		releaseMount( &homemnt );
+		initMountRelease( &homemnt );
 #endif
 	}
   }
@@ -986,39 +1491,12 @@ done:
 #endif
 
 #ifdef RSH_SUPPORT
-static int cpfd(int *pi, int o)
-{
-int  got,put,n;
-char buf[BUFSIZ];
-char *b = buf;
-
-	if ( (got = read( *pi, buf, sizeof(buf) )) < 0 ) {
-		fprintf(stderr,"rshCopy() -- cpfd unable to read");
-		return -1;
-	}
-
-	if ( 0 == got ) {
-		close(*pi);
-		*pi = -1;	
-		return 0;
-	}
-
-	b = buf;
-
-	for ( b = buf, n = got; n > 0; n-=put, b+=put ) {
-		if ( (put = write(o, b, n)) <= 0 ) {
-			fprintf(stderr,"rshCopy() -- cpfd unable to write");
-			return -1;
-		}
-	}
-	return got;
-}
-
 static int rshCopy(char **pDfltSrv, char *pathspec, char **pFnam)
 {
-int		fd = -1, ed = -1, tmpfd = -1, maxfd, got;
-fd_set	r,w,e;
-struct timeval timeout;
+static unsigned rshSeq = 0;
+int		fd = -1, ed = -1, st;
+char	*data = 0, *nbuf;
+size_t	len, cap = 0;
 
 int rval = -1;
 
@@ -1030,57 +1508,33 @@ int rval = -1;
 	
 	assert( !*pFnam );
 
-	*pFnam = strdup("/tmp/rshcpyXXXXXX");
-
-   	if ( (tmpfd=mkstemp(*pFnam)) < 0 ) {
-		perror("rshCopy() -- creating scratch file");
-		goto cleanup;
-	}
+	st = rshXfer( fd, ed, &data, &len, &cap );
+	/* rshXfer() closes both descriptors */
+	fd = ed = -1;
 
-	while ( fd >= 0 || ed >= 0 ) {
+	rshXferStats();
 
-		FD_ZERO( &r ); FD_ZERO( &w ); FD_ZERO( &e );
-		timeout.tv_sec  = 5;
-		timeout.tv_usec = 0;
-
-		maxfd = 0;
+	if ( st )
+		goto cleanup;
 
-		if ( fd >= 0 ) {
-			FD_SET( fd, &r );
-			if ( fd > maxfd )
-				maxfd = fd;
-		}
-		if ( ed >= 0 ) {
-			FD_SET( ed, &r );
-			if ( ed > maxfd )
-				maxfd = ed;
-		}
-		maxfd++;
+	/* give back the unused tail */
+	if ( (nbuf = memFileRealloc(data, len)) )
+		data = nbuf;
 
-		got = select(maxfd, &r, &w, &e, &timeout);
+	if ( !(*pFnam = malloc(30)) )
+		goto cleanup;
+	sprintf(*pFnam, "/tmp/rshcpy%u", rshSeq++);
 
-		if ( got <= 0 ) {
-			if ( got )
-				perror("rshCopy() network select() error");
-			else 
-				fprintf(stderr,"rshCopy() network select() timeout\n");
-			goto cleanup;
-		}
-		if ( ed >= 0 && FD_ISSET( ed, &r ) ) {
-			if ( cpfd( &ed, 2 ) < 0 ) {
-				perror(" error file descriptor");
-				goto cleanup;
-			}
-		}
-		if ( fd >= 0 && FD_ISSET( fd, &r ) ) {
-			if ( cpfd( &fd, tmpfd ) < 0 ) {
-				perror(" temp file descriptor");
-				goto cleanup;
-			}
-		}
+	if ( memFileCreate(*pFnam, data, len, 1) ) {
+		goto cleanup;
 	}
+	/* buffer is now owned by the file */
+	data = 0;
 
-	rval = tmpfd; tmpfd = -1;
+	if ( (rval = open(*pFnam, O_RDONLY)) < 0 ) {
+		perror("rshCopy() -- opening buffered file");
+		memFileRelease(*pFnam);
+	}
 
 cleanup:
 
@@ -1090,10 +1544,7 @@ cleanup:
 	if ( fd >= 0 )
 		close(fd);
 
-	if ( tmpfd >= 0 ) {
-		close(tmpfd);
-		unlink( *pFnam );
-	}
+	memFileFree( data );
 
 	if ( rval < 0 )
 		freeps(pFnam);
@@ -0,0 +1,132 @@
+/* Network buffer (mbuf/cluster) usage statistics
+ *
+ * The pool sizes are set by NET_MBUF_SPACE/NET_CLUSTER_SPACE
+ * (see init.c). To find out what a system really needs, start
+ * the sampler (from the Cexp shell or the system script)
+ *
+ *   mbufStatsStart(100)
+ *
+ * which records the peak number of mbufs/clusters in use every
+ * 100ms; mbufStats(0) prints current and peak usage along with
+ * the allocation failure and drop counters ('reset' nonzero
+ * clears the peaks). mbufStatsStop() ends sampling.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <rtems/rtems_bsdnet.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/mbuf.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/in_systm.h>
+#include <netinet/ip.h>
+#include <netinet/ip_var.h>
+#include <netinet/udp.h>
+#include <netinet/udp_var.h>
+
+extern struct mbstat  mbstat;
+extern struct ipstat  ipstat;
+extern struct udpstat udpstat;
+
+/* sampler.c */
+void *
+gesysSamplerCreate(const char *who, rtems_name name, rtems_task_priority prio, void (*sample)());
+
+int
+gesysSamplerStart(void *s, int period_ms);
+
+void
+gesysSamplerStop(void *s);
+
+int
+gesysSamplerRunning(void *s);
+
+#ifndef MBSTATS_PRIO
+#define MBSTATS_PRIO	250
+#endif
+
+typedef struct MbufSampleRec_ {
+	unsigned long	mbufsUsed,    mbufsPeak;
+	unsigned long	clustersUsed, clustersPeak;
+	unsigned long	nSamples;
+} MbufSampleRec;
+
+static MbufSampleRec      mbSample;
+static void              *mbSampler = 0;
+
+/* Take one sample; mbstat is only read (network semaphore not needed) */
+static void
+mbufSample()
+{
+unsigned long mb, cl;
+
+	mb = mbstat.m_mbufs    - mbstat.m_mtypes[MT_FREE];
+	cl = mbstat.m_clusters - mbstat.m_clfree;
+
+	mbSample.mbufsUsed    = mb;
+	mbSample.clustersUsed = cl;
+	if ( mb > mbSample.mbufsPeak )
+		mbSample.mbufsPeak = mb;
+	if ( cl > mbSample.clustersPeak )
+		mbSample.clustersPeak = cl;
+	mbSample.nSamples++;
+}
+
+/* Start sampling every 'period_ms' milliseconds (changes the
+ * period if already running).
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+mbufStatsStart(int period_ms)
+{
+	if ( !mbSampler ) {
+		mbSampler = gesysSamplerCreate("mbufStatsStart",
+					rtems_build_name('M','B','S','T'), MBSTATS_PRIO, mbufSample);
+		if ( !mbSampler )
+			return -1;
+	}
+	return gesysSamplerStart(mbSampler, period_ms);
+}
+
+/* Stop the sampler (it terminates at the end of the current period) */
+void
+mbufStatsStop()
+{
+	if ( mbSampler )
+		gesysSamplerStop(mbSampler);
+}
+
+/* Print statistics; clear peaks if 'reset' is nonzero */
+void
+mbufStats(int reset)
+{
+	/* current values even if the sampler is not running */
+	mbufSample();
+
+	printf("Network buffers (%s):\n",
+		mbSampler && gesysSamplerRunning(mbSampler) ? "sampler running" : "sampler off; peaks only from calls to mbufStats()");
+	printf("  pools:    %lu bytes mbufs, %lu bytes clusters\n",
+		(unsigned long)rtems_bsdnet_config.mbuf_bytecount,
+		(unsigned long)rtems_bsdnet_config.mbuf_cluster_bytecount);
+	printf("  mbufs:    %6lu allocated, %6lu in use, %6lu peak\n",
+		(unsigned long)mbstat.m_mbufs, mbSample.mbufsUsed, mbSample.mbufsPeak);
+	printf("  clusters: %6lu allocated, %6lu in use, %6lu peak\n",
+		(unsigned long)mbstat.m_clusters, mbSample.clustersUsed, mbSample.clustersPeak);
+	printf("  failed allocations: %lu, waits: %lu, drains: %lu\n",
+		(unsigned long)mbstat.m_drops, (unsigned long)mbstat.m_wait, (unsigned long)mbstat.m_drain);
+	printf("  drops: IP output %lu (no buffers), UDP %lu (socket buffer full)\n",
+		(unsigned long)ipstat.ips_odropped, (unsigned long)udpstat.udps_fullsock);
+	printf("  %lu samples\n", mbSample.nSamples);
+
+	if ( reset ) {
+		mbSample.mbufsPeak    = mbSample.mbufsUsed;
+		mbSample.clustersPeak = mbSample.clustersUsed;
+		mbSample.nSamples     = 0;
+	}
+}
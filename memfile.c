@@ -0,0 +1,188 @@
+/* Expose a memory area as a read-only file in the IMFS
+ * without copying it.
+ *
+ * rtems_tarfs_load() creates 'linear' IMFS files which
+ * reference the tar image in place. We synthesize a single
+ * 512-byte (ustar) header immediately preceding the data
+ * and hand this one-member 'archive' to rtems_tarfs_load().
+ *
+ * Memory obtained from memFileAlloc() reserves room for the
+ * header and for padding the data to a multiple of 512 bytes.
+ * Callers who manage their own memory (e.g., a reserved RAM
+ * area) must observe the same layout (see MEMFILE_HDR_SIZE,
+ * MEMFILE_PADDED()).
+ *
+ * Note that unlinking a linear file does not release the
+ * memory it references; memFileRelease() unlinks the file
+ * and frees the memory if it was obtained from memFileAlloc().
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <rtems/libio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "verscheck.h"
+
+#define MEMFILE_HDR_SIZE	512
+#define MEMFILE_PADDED(l)	(((l) + MEMFILE_HDR_SIZE - 1) & ~(MEMFILE_HDR_SIZE - 1))
+
+/* ustar header field offsets */
+#define TAR_NAME	0
+#define TAR_MODE	100
+#define TAR_SIZE	124
+#define TAR_MTIME	136
+#define TAR_CHKSUM	148
+#define TAR_TYPE	156
+#define TAR_MAGIC	257
+#define TAR_NAMELEN	100
+
+typedef struct MemFileRec_ {
+	struct MemFileRec_	*next;
+	char			*path;
+	void			*mem;	/* non-NULL if we own the memory */
+} MemFileRec, *MemFile;
+
+static MemFile memFiles = 0;
+
+/* Allocate memory for a file of 'len' bytes; the returned
+ * pointer is to the data area.
+ */
+void *
+memFileAlloc(size_t len)
+{
+char *p;
+	if ( !(p = malloc(MEMFILE_HDR_SIZE + MEMFILE_PADDED(len))) )
+		return 0;
+	return p + MEMFILE_HDR_SIZE;
+}
+
+/* Resize an area obtained from memFileAlloc(); the data
+ * are preserved. Must not be used once a file has been
+ * created.
+ */
+void *
+memFileRealloc(void *data, size_t len)
+{
+char *p = data ? (char*)data - MEMFILE_HDR_SIZE : 0;
+	if ( !(p = realloc(p, MEMFILE_HDR_SIZE + MEMFILE_PADDED(len))) )
+		return 0;
+	return p + MEMFILE_HDR_SIZE;
+}
+
+/* Release an area obtained from memFileAlloc() which has
+ * not been turned into a file.
+ */
+void
+memFileFree(void *data)
+{
+	if ( data )
+		free( (char*)data - MEMFILE_HDR_SIZE );
+}
+
+/* Fill the tar header preceding 'data' */
+static int
+memFileHdr(char *hdr, const char *name, size_t len)
+{
+unsigned sum;
+int      i;
+
+	if ( strlen(name) >= TAR_NAMELEN ) {
+		fprintf(stderr,"memFile: name '%s' too long\n", name);
+		return -1;
+	}
+	memset(hdr, 0, MEMFILE_HDR_SIZE);
+	strcpy(hdr + TAR_NAME, name);
+	sprintf(hdr + TAR_MODE,  "%07o",   0444);
+	sprintf(hdr + TAR_SIZE,  "%011lo", (unsigned long)len);
+	sprintf(hdr + TAR_MTIME, "%011lo", (unsigned long)time(0));
+	hdr[TAR_TYPE] = '0';
+	memcpy(hdr + TAR_MAGIC, "ustar\0" "00", 8);
+
+	/* checksum is computed with the checksum field set to blanks */
+	memset(hdr + TAR_CHKSUM, ' ', 8);
+	for ( sum = 0, i = 0; i < MEMFILE_HDR_SIZE; i++ )
+		sum += 0xff & hdr[i];
+	sprintf(hdr + TAR_CHKSUM, "%06o", sum);
+	hdr[TAR_CHKSUM + 7] = ' ';
+	return 0;
+}
+
+/* Create a read-only file 'path' (absolute path; the directory
+ * must exist) referencing 'len' bytes at 'data'. The MEMFILE_HDR_SIZE
+ * bytes preceding 'data' are overwritten.
+ * If 'owned' is nonzero then 'data' must have been obtained from
+ * memFileAlloc() and is released by memFileRelease().
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+memFileCreate(const char *path, void *data, size_t len, int owned)
+{
+char    *dir   = 0;
+char    *slash;
+MemFile  mf    = 0;
+int      rval  = -1, st;
+
+	if ( !path || '/' != *path || !(dir = strdup(path)) )
+		goto bail;
+
+	slash  = strrchr(dir, '/');
+	*slash = 0;
+
+	if ( memFileHdr((char*)data - MEMFILE_HDR_SIZE, slash + 1, len) )
+		goto bail;
+
+	if ( !(mf = malloc(sizeof(*mf))) || !(mf->path = strdup(path)) )
+		goto bail;
+
+	st = rtems_tarfs_load( *dir ? dir : "/",
+	                       (void*)((char*)data - MEMFILE_HDR_SIZE),
+	                       MEMFILE_HDR_SIZE + MEMFILE_PADDED(len) );
+	if ( st ) {
+		fprintf(stderr,"memFile: creating '%s' failed (rtems_tarfs_load: %i)\n", path, st);
+		free(mf->path);
+		goto bail;
+	}
+
+	mf->mem  = owned ? (char*)data - MEMFILE_HDR_SIZE : 0;
+	mf->next = memFiles;
+	memFiles = mf;
+	mf       = 0;
+	rval     = 0;
+
+bail:
+	free(mf);
+	free(dir);
+	return rval;
+}
+
+/* Unlink a file created by memFileCreate() and release
+ * its memory (if owned).
+ *
+ * RETURNS: 0 on success, -1 if 'path' is not a memFile.
+ */
+int
+memFileRelease(const char *path)
+{
+MemFile *pp, mf;
+
+	for ( pp = &memFiles; (mf = *pp); pp = &mf->next ) {
+		if ( !strcmp(mf->path, path) ) {
+			*pp = mf->next;
+			unlink( mf->path );
+			free( mf->mem );
+			free( mf->path );
+			free( mf );
+			return 0;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,379 @@
+/* Table of NFS mounts made during initialization
+ *
+ * Init() mounts the export holding the symbol file on /boot and
+ * the one holding the user (INIT) script on /home. The table
+ *
+ *  - lets a mount be started in the background (mntTabMountAsync())
+ *    so that e.g. the INIT script's export is mounted while the
+ *    system script executes; mntTabWait() collects the result.
+ *  - shares mounts: a request for <host>:<path> is satisfied by an
+ *    existing (or pending) mount of <host>:<export> if <export> is
+ *    a prefix of <path> (e.g., /boot from srv:/remote serves
+ *    srv:/remote/iocs/ioc1 as /boot/iocs/ioc1).
+ *  - records how long every mount took; mntTabShow() lists them.
+ *
+ * Mounts made by somebody else (e.g., /boot by isNfsPath()) can be
+ * entered with mntTabAdd() so they can be shared, too.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NFS_SUPPORT
+#include <librtemsNfs.h>
+
+#ifndef MNTTAB_PRIO
+#define MNTTAB_PRIO		150
+#endif
+
+#define MNT_PENDING		0
+#define MNT_OK			1
+#define MNT_FAILED		(-1)
+
+typedef struct MntTabEntRec_ {
+	struct MntTabEntRec_	*next;
+	char					*uidhost, *rpath, *mntpt;
+	int						refs;
+	int						owned;		/* we mounted it; unmount when released */
+	volatile int			status;
+	rtems_id				gate;		/* available once the mount is done     */
+	rtems_interval			t_start, t_end;
+} MntTabEntRec, *MntTabEnt;
+
+static MntTabEnt mntTab     = 0;
+static rtems_id  mntTabLock = 0;
+static unsigned  mntTabSeq  = 0;
+
+static int
+mntTabInit()
+{
+rtems_status_code sc;
+
+	if ( mntTabLock )
+		return 0;
+	sc = rtems_semaphore_create(
+			rtems_build_name('M','N','T','L'),
+			1,
+			RTEMS_BINARY_SEMAPHORE | RTEMS_PRIORITY | RTEMS_INHERIT_PRIORITY,
+			0,
+			&mntTabLock);
+	if ( RTEMS_SUCCESSFUL != sc ) {
+		fprintf(stderr,"mntTab: unable to create lock (%s)\n", rtems_status_text(sc));
+		return -1;
+	}
+	return 0;
+}
+
+#define LOCK()		rtems_semaphore_obtain(mntTabLock, RTEMS_WAIT, RTEMS_NO_TIMEOUT)
+#define UNLOCK()	rtems_semaphore_release(mntTabLock)
+
+static unsigned long
+ms(rtems_interval ticks)
+{
+rtems_interval tps;
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+	return (unsigned long)ticks * 1000UL / tps;
+}
+
+/* Is 'export' a prefix of 'path' (at a component boundary)?
+ * RETURNS: length of the prefix (ignoring trailing '/') or -1.
+ */
+static int
+isPrefix(const char *export, const char *path)
+{
+int l = strlen(export);
+	while ( l > 1 && '/' == export[l-1] )
+		l--;
+	if ( strncmp(export, path, l) )
+		return -1;
+	if ( path[l] && '/' != path[l] && !(1 == l && '/' == export[0]) )
+		return -1;
+	return l;
+}
+
+/* find a (pending or completed) mount which can serve the request;
+ * must hold the lock.
+ */
+static MntTabEnt
+mntTabFind(const char *uidhost, const char *rpath)
+{
+MntTabEnt e;
+	for ( e = mntTab; e; e = e->next ) {
+		if ( MNT_FAILED != e->status && 0 == strcmp(e->uidhost, uidhost) && isPrefix(e->rpath, rpath) >= 0 )
+			return e;
+	}
+	return 0;
+}
+
+static MntTabEnt
+mntTabCreate(const char *uidhost, const char *rpath, const char *mntpt)
+{
+MntTabEnt e;
+
+	if ( !(e = calloc(1, sizeof(*e))) )
+		return 0;
+	e->uidhost = strdup(uidhost);
+	e->rpath   = strdup(rpath);
+	e->mntpt   = strdup(mntpt);
+	if ( !e->uidhost || !e->rpath || !e->mntpt ) {
+		free(e->uidhost); free(e->rpath); free(e->mntpt); free(e);
+		return 0;
+	}
+	e->refs   = 1;
+	e->status = MNT_PENDING;
+	return e;
+}
+
+static void
+mntTabDestroy(MntTabEnt e)
+{
+MntTabEnt *pp;
+	for ( pp = &mntTab; *pp; pp = &(*pp)->next ) {
+		if ( *pp == e ) {
+			*pp = e->next;
+			break;
+		}
+	}
+	if ( e->gate )
+		rtems_semaphore_delete(e->gate);
+	free(e->uidhost);
+	free(e->rpath);
+	free(e->mntpt);
+	free(e);
+}
+
+static void
+mntTabDoMount(MntTabEnt e)
+{
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &e->t_start );
+	e->status = nfsMount(e->uidhost, e->rpath, e->mntpt) ? MNT_FAILED : MNT_OK;
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &e->t_end );
+	printf("NFS mount of '%s:%s' on '%s' %s (%lums)\n",
+		e->uidhost, e->rpath, e->mntpt,
+		MNT_OK == e->status ? "done" : "FAILED",
+		ms(e->t_end - e->t_start));
+	if ( e->gate )
+		rtems_semaphore_release(e->gate);
+}
+
+static rtems_task
+mntTabTask(rtems_task_argument arg)
+{
+	mntTabDoMount((MntTabEnt)arg);
+	rtems_task_delete( RTEMS_SELF );
+}
+
+/* Enter a mount which was made elsewhere ('ms_taken': how long it took,
+ * for the report); it is shared but never unmounted by the table.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+mntTabAdd(const char *uidhost, const char *rpath, const char *mntpt, unsigned long ms_taken)
+{
+MntTabEnt      e;
+rtems_interval tps;
+
+	if ( mntTabInit() || !(e = mntTabCreate(uidhost, rpath, mntpt)) )
+		return -1;
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &e->t_end );
+	e->t_start = e->t_end - ms_taken * tps / 1000;
+	e->status  = MNT_OK;
+	LOCK();
+	e->next = mntTab;
+	mntTab  = e;
+	UNLOCK();
+	return 0;
+}
+
+/* Remove a mount entered with mntTabAdd() (before it is unmounted
+ * by its owner). The entry is left alone while the mount is shared
+ * (i.e., handed out by mntTabMountAsync() and not released yet).
+ *
+ * RETURNS: 0 on success, -1 if not found, 1 if still in use.
+ */
+int
+mntTabForget(const char *mntpt)
+{
+MntTabEnt e;
+int       rval = -1;
+
+	if ( !mntTabLock )
+		return -1;
+	LOCK();
+	for ( e = mntTab; e; e = e->next ) {
+		if ( !e->owned && 0 == strcmp(e->mntpt, mntpt) ) {
+			/* external entries hold one reference of their own */
+			if ( e->refs > 1 ) {
+				rval = 1;
+			} else {
+				mntTabDestroy(e);
+				rval = 0;
+			}
+			break;
+		}
+	}
+	UNLOCK();
+	return rval;
+}
+
+/* Request <uidhost>:<rpath> to be mounted on 'mntpt' unless an
+ * existing mount can be shared; the mount is performed by a
+ * separate task. The caller must eventually call mntTabWait()
+ * and mntTabRelease().
+ *
+ * RETURNS: handle or NULL on error.
+ */
+void *
+mntTabMountAsync(const char *uidhost, const char *rpath, const char *mntpt)
+{
+MntTabEnt         e;
+rtems_status_code sc;
+rtems_id          tid;
+
+	if ( mntTabInit() )
+		return 0;
+
+	LOCK();
+	if ( (e = mntTabFind(uidhost, rpath)) ) {
+		e->refs++;
+		UNLOCK();
+		printf("NFS: '%s:%s' is served by the mount on '%s'\n", uidhost, rpath, e->mntpt);
+		return e;
+	}
+	for ( e = mntTab; e; e = e->next ) {
+		if ( 0 == strcmp(e->mntpt, mntpt) ) {
+			UNLOCK();
+			fprintf(stderr,"NFS: '%s' is already in use by '%s:%s'\n", mntpt, e->uidhost, e->rpath);
+			return 0;
+		}
+	}
+	if ( !(e = mntTabCreate(uidhost, rpath, mntpt)) ) {
+		UNLOCK();
+		return 0;
+	}
+	e->owned = 1;
+	e->next  = mntTab;
+	mntTab   = e;
+	UNLOCK();
+
+	sc = rtems_semaphore_create(
+			rtems_build_name('M','N','T','G'),
+			0,
+			RTEMS_COUNTING_SEMAPHORE | RTEMS_FIFO,
+			0,
+			&e->gate);
+	if ( RTEMS_SUCCESSFUL == sc ) {
+		sc = rtems_task_create(
+				rtems_build_name('M','N','T','0' + (mntTabSeq++ % 10)),
+				MNTTAB_PRIO,
+				4*RTEMS_MINIMUM_STACK_SIZE,
+				RTEMS_DEFAULT_MODES,
+				RTEMS_FLOATING_POINT | RTEMS_LOCAL,
+				&tid);
+		if ( RTEMS_SUCCESSFUL == sc ) {
+			sc = rtems_task_start( tid, mntTabTask, (rtems_task_argument)e );
+			if ( RTEMS_SUCCESSFUL != sc )
+				rtems_task_delete( tid );
+		}
+	}
+	if ( RTEMS_SUCCESSFUL != sc ) {
+		fprintf(stderr,"NFS: unable to mount in the background (%s); mounting now\n", rtems_status_text(sc));
+		mntTabDoMount(e);
+	}
+	return e;
+}
+
+/* Wait for a mount requested by mntTabMountAsync() to complete.
+ * If 'pdir' is non-NULL the local directory which corresponds to
+ * 'rpath' is returned in *pdir (malloc()ed).
+ *
+ * RETURNS: 0 on success, -1 if the mount failed.
+ */
+int
+mntTabWait(void *h, const char *rpath, char **pdir)
+{
+MntTabEnt e = h;
+int       l;
+
+	if ( !e )
+		return -1;
+	if ( e->gate ) {
+		/* gate stays available once the mount is done */
+		rtems_semaphore_obtain(e->gate, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+		rtems_semaphore_release(e->gate);
+	}
+	if ( MNT_OK != e->status )
+		return -1;
+	if ( pdir ) {
+		if ( !rpath || (l = isPrefix(e->rpath, rpath)) < 0 )
+			return -1;
+		if ( !(*pdir = malloc(strlen(e->mntpt) + strlen(rpath + l) + 1)) )
+			return -1;
+		strcat(strcpy(*pdir, e->mntpt), rpath + l);
+	}
+	return 0;
+}
+
+/* Release a mount obtained from mntTabMountAsync(); the last user
+ * of a mount made by the table unmounts it.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+mntTabRelease(void *h)
+{
+MntTabEnt e = h;
+int       rval = 0;
+
+	if ( !e )
+		return 0;
+	/* the mount task must be done with the entry */
+	mntTabWait(e, 0, 0);
+	LOCK();
+	if ( 0 == --e->refs ) {
+		if ( e->owned ) {
+			if ( MNT_OK == e->status && unmount(e->mntpt) ) {
+				fprintf(stderr,"NFS: unable to unmount '%s'\n", e->mntpt);
+				rval = -1;
+			}
+			mntTabDestroy(e);
+		} else {
+			/* external mounts stay until mntTabForget() */
+			e->refs = 1;
+		}
+	}
+	UNLOCK();
+	return rval;
+}
+
+/* List the mounts and how long they took */
+void
+mntTabShow()
+{
+MntTabEnt e;
+
+	if ( !mntTabLock ) {
+		printf("No NFS mounts recorded\n");
+		return;
+	}
+	printf("%-12s %-40s %4s %-8s %s\n", "Mount point", "Export", "Refs", "Status", "Time");
+	LOCK();
+	for ( e = mntTab; e; e = e->next ) {
+		printf("%-12s %-40s %4d %-8s ", e->mntpt, e->rpath, e->refs,
+			MNT_OK == e->status ? "OK" : (MNT_PENDING == e->status ? "PENDING" : "FAILED"));
+		if ( MNT_PENDING == e->status )
+			printf("-\n");
+		else
+			printf("%lums\n", ms(e->t_end - e->t_start));
+	}
+	UNLOCK();
+}
+
+#endif
@@ -0,0 +1,224 @@
+/* Object pool and workspace utilization report
+ *
+ * config.c configures most object classes with
+ * rtems_resource_unlimited(N): whenever all objects of a class
+ * are in use, RTEMS extends the class by another block of N
+ * objects taken from the workspace. Use
+ *
+ *   objReport(0)
+ *
+ * from the Cexp shell to list, for every class which is in use,
+ *
+ *   in use   objects in use now
+ *   peak     max. in use seen by any sample
+ *   cap.     current capacity (allocated objects, i.e., the
+ *            configured number plus extensions)
+ *   1st cap  capacity at the first sample (or the last reset);
+ *            this is the configured number only if the class was
+ *            not extended before
+ *   grew     number of samples which found the capacity grown
+ *            (several extensions between two samples count once)
+ *
+ * plus the workspace headroom ('reset' nonzero clears peaks and
+ * counters). The public API does not tell the configured number
+ * (or the size of an extension block); see config.c for these.
+ *
+ *   objReportStart(1000)
+ *
+ * starts sampling every second so that short-lived peaks and
+ * extensions are caught; objReportStop() ends sampling.
+ *
+ * The results may be used to tune the numbers in config.c and
+ * CONFIGURE_EXECUTIVE_RAM_SIZE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#else
+#include "verscheck.h"
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <string.h>
+
+#if RTEMS_VERSION_ATLEAST(4,9,0)
+#include <rtems/score/heap.h>
+
+/* sampler.c */
+void *
+gesysSamplerCreate(const char *who, rtems_name name, rtems_task_priority prio, void (*sample)());
+
+int
+gesysSamplerStart(void *s, int period_ms);
+
+void
+gesysSamplerStop(void *s);
+
+int
+gesysSamplerRunning(void *s);
+
+#ifndef OBJREPORT_PRIO
+#define OBJREPORT_PRIO		250
+#endif
+
+/* enough for all classes of the internal, classic and POSIX APIs */
+#define OBJREPORT_MAX_CLASSES	40
+
+typedef struct ObjClassRec_ {
+	int				api, cls;
+	unsigned long	inUse, peak;
+	unsigned long	maximum, firstMax;	/* capacity now and at first sample */
+	unsigned long	grown;				/* samples which found it grown     */
+	int				autoExtend;
+} ObjClassRec, *ObjClass;
+
+static ObjClassRec   objClasses[OBJREPORT_MAX_CLASSES];
+static int           nObjClasses = 0;
+static unsigned long wsMinFree   = (unsigned long)-1;
+static unsigned long objSamples  = 0;
+
+static void         *objSampler  = 0;
+
+static ObjClass
+objClassFind(int api, int cls)
+{
+int i;
+	for ( i = 0; i < nObjClasses; i++ ) {
+		if ( objClasses[i].api == api && objClasses[i].cls == cls )
+			return &objClasses[i];
+	}
+	if ( nObjClasses >= OBJREPORT_MAX_CLASSES )
+		return 0;
+	memset(&objClasses[nObjClasses], 0, sizeof(objClasses[0]));
+	objClasses[nObjClasses].api = api;
+	objClasses[nObjClasses].cls = cls;
+	return &objClasses[nObjClasses++];
+}
+
+static void
+objSample()
+{
+rtems_object_api_class_information info;
+Heap_Information_block             wsinfo;
+ObjClass                           c;
+int                                api, cls;
+unsigned long                      used;
+
+	for ( api = rtems_object_id_api_minimum(); api <= rtems_object_id_api_maximum(); api++ ) {
+		if ( rtems_object_api_minimum_class(api) < 0 )
+			continue;
+		for ( cls = rtems_object_api_minimum_class(api); cls <= rtems_object_api_maximum_class(api); cls++ ) {
+			if ( RTEMS_SUCCESSFUL != rtems_object_get_class_information(api, cls, &info) )
+				continue;
+			if ( 0 == info.maximum || !(c = objClassFind(api, cls)) )
+				continue;
+
+			used = info.maximum - info.unallocated;
+
+			if ( 0 == c->firstMax )
+				c->firstMax = info.maximum;
+			else if ( info.maximum > c->maximum )
+				c->grown++;
+
+			c->maximum    = info.maximum;
+			c->autoExtend = info.auto_extend;
+			c->inUse      = used;
+			if ( used > c->peak )
+				c->peak = used;
+		}
+	}
+
+	if ( RTEMS_SUCCESSFUL == rtems_workspace_get_information(&wsinfo) ) {
+		if ( wsinfo.Free.total < wsMinFree )
+			wsMinFree = wsinfo.Free.total;
+	}
+	objSamples++;
+}
+
+/* Start sampling every 'period_ms' milliseconds (changes the
+ * period if already running).
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+objReportStart(int period_ms)
+{
+	if ( !objSampler ) {
+		objSampler = gesysSamplerCreate("objReportStart",
+					rtems_build_name('O','B','J','R'), OBJREPORT_PRIO, objSample);
+		if ( !objSampler )
+			return -1;
+	}
+	return gesysSamplerStart(objSampler, period_ms);
+}
+
+/* Stop the sampler (it terminates at the end of the current period) */
+void
+objReportStop()
+{
+	if ( objSampler )
+		gesysSamplerStop(objSampler);
+}
+
+/* Print the report (see above for the columns); clear peaks
+ * and counters if 'reset' is nonzero.
+ */
+void
+objReport(int reset)
+{
+Heap_Information_block wsinfo;
+ObjClass               c;
+int                    i;
+
+	/* current values even if the sampler is not running */
+	objSample();
+
+	printf("%-32s %7s %7s %7s %7s %5s\n", "Object class", "in use", "peak", "cap.", "1st cap", "grew");
+	for ( i = 0, c = objClasses; i < nObjClasses; i++, c++ ) {
+		printf("%-32s %7lu %7lu %7lu %7lu %5lu%s\n",
+			rtems_object_get_api_class_name(c->api, c->cls),
+			c->inUse, c->peak, c->maximum, c->firstMax, c->grown,
+			c->autoExtend ? "" : " (fixed)");
+	}
+
+	if ( RTEMS_SUCCESSFUL == rtems_workspace_get_information(&wsinfo) ) {
+		printf("Workspace: %lu bytes used, %lu free (largest block %lu), min. free %lu\n",
+			(unsigned long)wsinfo.Used.total,
+			(unsigned long)wsinfo.Free.total,
+			(unsigned long)wsinfo.Free.largest,
+			wsMinFree);
+	}
+	printf("%lu samples (sampler %s)\n", objSamples, objSampler && gesysSamplerRunning(objSampler) ? "running" : "off");
+
+	if ( reset ) {
+		for ( i = 0, c = objClasses; i < nObjClasses; i++, c++ ) {
+			c->peak     = c->inUse;
+			c->firstMax = c->maximum;
+			c->grown    = 0;
+		}
+		wsMinFree  = (unsigned long)-1;
+		objSamples = 0;
+	}
+}
+
+#else
+
+int
+objReportStart(int period_ms)
+{
+	fprintf(stderr,"objReportStart(): needs RTEMS 4.9 or later\n");
+	return -1;
+}
+
+void
+objReportStop()
+{
+}
+
+void
+objReport(int reset)
+{
+	fprintf(stderr,"objReport(): needs RTEMS 4.9 or later\n");
+}
+
+#endif
@@ -0,0 +1,593 @@
+/* Fetch the modules a script loads concurrently, ahead of execution
+ *
+ * Scripts load their modules one after another ('ld("x.obj")', i.e.,
+ * cexpModuleLoad()) and every load waits for the file to be transferred
+ * over TFTP or NFS. Before a script is executed
+ *
+ *   gesysPrefetchScript(dir, script)
+ *
+ * collects the modules it loads, either from an explicit manifest
+ * '<script>.prefetch' (one file name per line; '#' starts a comment)
+ * or by scanning the script for 'ld("<file>")' and
+ * 'cexpModuleLoad("<file>"' (the scan stops at the first 'chdir' since
+ * relative names could then no longer be resolved). Relative names
+ * are resolved against 'dir' (the directory the script is executed
+ * in; NULL: the script's directory).
+ *
+ * PREFETCH_TASKS tasks read the files into memory; they stop fetching
+ * ahead while PREFETCH_MAX_AHEAD modules or PREFETCH_MAX_BYTES bytes
+ * are held (transferred or in transfer but not loaded yet). cexpModuleLoad()
+ * is wrapped (link with -Wl,--wrap,cexpModuleLoad; see configure's
+ * --enable-prefetch) and loads a module which was prefetched from a
+ * memFile on /tmp (waiting for the transfer to complete if necessary).
+ * The name must be spelled as in the script. Note that Cexp sees the
+ * memFile, i.e., its messages and the module's file name (as shown
+ * by cexpModuleInfo()) refer to '/tmp/prefetch<n>.obj' which no longer
+ * exists after the load (the module name is the original file name
+ * unless one was passed). Modules which have not been picked up by
+ * a task yet, as well as failed transfers, are loaded normally.
+ * gesysPrefetchFlush() releases whatever the script did not load
+ * and reports statistics.
+ *
+ * If the symbol usage profile recorder is enabled, too (symprof.c),
+ * the wrapper records the modules on its behalf.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctype.h>
+
+#ifndef PREFETCH_TASKS
+#define PREFETCH_TASKS		4
+#endif
+
+#ifndef PREFETCH_PRIO
+#define PREFETCH_PRIO		150
+#endif
+
+#ifndef PREFETCH_MAX_AHEAD
+#define PREFETCH_MAX_AHEAD	8
+#endif
+
+#ifndef PREFETCH_MAX_BYTES
+#define PREFETCH_MAX_BYTES	(4*1024*1024)
+#endif
+
+#define PREFETCH_CHUNK		16384
+#define PREFETCH_MANIFEST	".prefetch"
+
+extern void *__real_cexpModuleLoad(char *file, char *name);
+
+void *
+memFileAlloc(size_t len);
+
+void *
+memFileRealloc(void *data, size_t len);
+
+void
+memFileFree(void *data);
+
+int
+memFileCreate(const char *path, void *data, size_t len, int owned);
+
+int
+memFileRelease(const char *path);
+
+/* symprof.c (optional) */
+extern void symProfRecord(const char *file) __attribute__((weak));
+
+#define PF_QUEUED	0
+#define PF_BUSY		1
+#define PF_DONE		2
+#define PF_FAILED	3
+
+typedef struct PrefetchEntRec_ {
+	struct PrefetchEntRec_	*next;
+	char					*name;		/* as spelled in the script */
+	char					*path;		/* absolute path to fetch   */
+	char					*data;		/* from memFileAlloc()      */
+	size_t					len;
+	int						status;
+} PrefetchEntRec, *PrefetchEnt;
+
+static PrefetchEnt pfList     = 0;
+static rtems_id    pfLock     = 0;
+static rtems_id    pfDone     = 0;	/* released for each waiter when the list changes */
+static int         pfWaiters  = 0;
+static int         pfTasks    = 0;
+static unsigned    pfSeq      = 0;
+static unsigned    pfFileSeq  = 0;
+
+static struct {
+	unsigned       listed, fetched, failed, hits;
+	unsigned long  bytes;
+	rtems_interval t_start;
+} pfStats;
+
+#define LOCK()		rtems_semaphore_obtain(pfLock, RTEMS_WAIT, RTEMS_NO_TIMEOUT)
+#define UNLOCK()	rtems_semaphore_release(pfLock)
+
+static int
+pfInit()
+{
+rtems_status_code sc;
+
+	if ( pfLock )
+		return 0;
+	sc = rtems_semaphore_create(
+			rtems_build_name('P','F','L','K'),
+			1,
+			RTEMS_BINARY_SEMAPHORE | RTEMS_PRIORITY | RTEMS_INHERIT_PRIORITY,
+			0,
+			&pfLock);
+	if ( RTEMS_SUCCESSFUL == sc ) {
+		sc = rtems_semaphore_create(
+				rtems_build_name('P','F','D','N'),
+				0,
+				RTEMS_COUNTING_SEMAPHORE | RTEMS_FIFO,
+				0,
+				&pfDone);
+		if ( RTEMS_SUCCESSFUL != sc ) {
+			rtems_semaphore_delete(pfLock);
+			pfLock = 0;
+		}
+	}
+	if ( RTEMS_SUCCESSFUL != sc ) {
+		fprintf(stderr,"gesysPrefetch: unable to create semaphores (%s)\n", rtems_status_text(sc));
+		return -1;
+	}
+	return 0;
+}
+
+static void
+pfEntFree(PrefetchEnt e)
+{
+	memFileFree(e->data);
+	free(e->path);
+	free(e->name);
+	free(e);
+}
+
+/* unlink 'e' from the list; must hold the lock */
+static void
+pfUnlink(PrefetchEnt e)
+{
+PrefetchEnt *pp;
+	for ( pp = &pfList; *pp; pp = &(*pp)->next ) {
+		if ( *pp == e ) {
+			*pp = e->next;
+			return;
+		}
+	}
+}
+
+/* wake everybody waiting for a transfer to complete or for room
+ * in the cache; must hold the lock
+ */
+static void
+pfWakeup()
+{
+	while ( pfWaiters > 0 ) {
+		pfWaiters--;
+		rtems_semaphore_release(pfDone);
+	}
+}
+
+/* wait for pfWakeup(); must hold the lock (which is released
+ * while waiting)
+ */
+static void
+pfWait()
+{
+	pfWaiters++;
+	UNLOCK();
+	rtems_semaphore_obtain(pfDone, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+	LOCK();
+}
+
+/* may another transfer be started? must hold the lock */
+static int
+pfRoom()
+{
+PrefetchEnt   e;
+int           n     = 0;
+unsigned long bytes = 0;
+
+	for ( e = pfList; e; e = e->next ) {
+		if ( PF_BUSY == e->status || PF_DONE == e->status ) {
+			n++;
+			bytes += e->len;
+		}
+	}
+	/* always allow one (even if it exceeds the byte limit) */
+	return 0 == n || ( n < PREFETCH_MAX_AHEAD && bytes < PREFETCH_MAX_BYTES );
+}
+
+/* read the file at e->path into memory; RETURNS 0 on success */
+static int
+pfFetch(PrefetchEnt e)
+{
+int     fd;
+ssize_t got;
+size_t  cap = PREFETCH_CHUNK;
+char    *nbuf;
+
+	if ( (fd = open(e->path, O_RDONLY)) < 0 )
+		return -1;
+
+	if ( !(e->data = memFileAlloc(cap)) )
+		goto bail;
+
+	e->len = 0;
+	while ( (got = read(fd, e->data + e->len, cap - e->len)) > 0 ) {
+		e->len += got;
+		if ( e->len == cap ) {
+			if ( !(nbuf = memFileRealloc(e->data, 2*cap)) )
+				goto bail;
+			e->data = nbuf;
+			cap    *= 2;
+		}
+	}
+	if ( got < 0 )
+		goto bail;
+
+	close(fd);
+	return 0;
+
+bail:
+	close(fd);
+	memFileFree(e->data);
+	e->data = 0;
+	return -1;
+}
+
+static rtems_task
+pfTask(rtems_task_argument arg)
+{
+PrefetchEnt e;
+int         st;
+
+	LOCK();
+	for (;;) {
+		for ( e = pfList; e && PF_QUEUED != e->status; e = e->next )
+			;
+		if ( !e )
+			break;
+		if ( !pfRoom() ) {
+			/* wait for the loader to catch up */
+			pfWait();
+			continue;
+		}
+		e->status = PF_BUSY;
+		UNLOCK();
+
+		st = pfFetch(e);
+
+		LOCK();
+		if ( st ) {
+			e->status = PF_FAILED;
+			pfStats.failed++;
+		} else {
+			e->status = PF_DONE;
+			pfStats.fetched++;
+			pfStats.bytes += e->len;
+		}
+		pfWakeup();
+	}
+	pfTasks--;
+	UNLOCK();
+
+	rtems_task_delete( RTEMS_SELF );
+}
+
+/* queue 'name' (relative to 'dir') at the tail so that modules
+ * are fetched in the order they are loaded; must hold the lock
+ */
+static void
+pfAdd(const char *dir, const char *name)
+{
+PrefetchEnt e, *pp;
+
+	for ( pp = &pfList; (e = *pp); pp = &e->next ) {
+		if ( 0 == strcmp(e->name, name) )
+			return;
+	}
+	if ( !(e = calloc(1, sizeof(*e))) )
+		return;
+	if ( !(e->name = strdup(name)) || !(e->path = malloc(strlen(dir) + strlen(name) + 2)) ) {
+		pfEntFree(e);
+		return;
+	}
+	if ( '/' == *name )
+		strcpy(e->path, name);
+	else
+		sprintf(e->path, "%s%s%s", dir, '/' == dir[strlen(dir)-1] ? "" : "/", name);
+	e->status = PF_QUEUED;
+	*pp       = e;
+	pfStats.listed++;
+}
+
+#define ISIDCHAR(c)	( isalnum((unsigned char)(c)) || '_' == (c) )
+
+/* If 'p' points to 'ld("<file>"' or 'cexpModuleLoad("<file>"'
+ * return <file> (terminated in place) and set *pend past it.
+ */
+static char *
+pfModuleName(char *p, char **pend)
+{
+char *q;
+
+	if ( 0 == strncmp(p, "ld", 2) && !ISIDCHAR(p[2]) )
+		p += 2;
+	else if ( 0 == strncmp(p, "cexpModuleLoad", 14) && !ISIDCHAR(p[14]) )
+		p += 14;
+	else
+		return 0;
+	while ( isspace((unsigned char)*p) )
+		p++;
+	if ( '(' != *p++ )
+		return 0;
+	while ( isspace((unsigned char)*p) )
+		p++;
+	if ( '"' != *p++ || !(q = strchr(p, '"')) )
+		return 0;
+	*q    = 0;
+	*pend = q;
+	return p;
+}
+
+/* add the modules listed in a manifest or loaded by a script;
+ * must hold the lock.
+ */
+static void
+pfScan(FILE *f, const char *dir, int manifest)
+{
+char line[512], *p, *e, *name;
+
+	while ( fgets(line, sizeof(line), f) ) {
+		for ( p = line; isspace((unsigned char)*p); p++ )
+			;
+		if ( !*p || '#' == *p || ('/' == p[0] && '/' == p[1]) )
+			continue;
+
+		if ( manifest ) {
+			for ( e = p + strlen(p); e > p && isspace((unsigned char)e[-1]); e-- )
+				;
+			*e = 0;
+			pfAdd(dir, p);
+			continue;
+		}
+
+		/* relative names could no longer be resolved */
+		if ( strstr(p, "chdir") )
+			break;
+
+		for ( ; *p; p++ ) {
+			if ( p > line && ISIDCHAR(p[-1]) )
+				continue;
+			if ( (name = pfModuleName(p, &e)) ) {
+				pfAdd(dir, name);
+				p = e;
+			}
+		}
+	}
+}
+
+/* Collect the modules 'script' loads (see above) and start fetching
+ * them.
+ *
+ * RETURNS: number of modules queued or -1 on error.
+ */
+int
+gesysPrefetchScript(const char *dir, const char *script)
+{
+char              *path = 0, *pdir = 0, *slash;
+FILE              *f;
+int               fd, manifest, n = -1, i;
+unsigned          listed;
+rtems_status_code sc;
+rtems_id          tid;
+
+	if ( !script || pfInit() )
+		return -1;
+
+	if ( !dir ) {
+		if ( !(pdir = strdup(script)) || !(slash = strrchr(pdir, '/')) )
+			goto bail;
+		slash[1] = 0;
+		dir = pdir;
+	}
+	if ( '/' != *dir ) {
+		/* tasks don't share our current directory */
+		goto bail;
+	}
+
+	if ( !(path = malloc(strlen(dir) + strlen(script) + strlen(PREFETCH_MANIFEST) + 2)) )
+		goto bail;
+	if ( '/' == *script )
+		strcpy(path, script);
+	else
+		sprintf(path, "%s%s%s", dir, '/' == dir[strlen(dir)-1] ? "" : "/", script);
+
+	/* an explicit manifest takes precedence */
+	strcat(path, PREFETCH_MANIFEST);
+	if ( (fd = open(path, O_RDONLY)) < 0 ) {
+		path[strlen(path) - strlen(PREFETCH_MANIFEST)] = 0;
+		fd = open(path, O_RDONLY);
+		manifest = 0;
+	} else {
+		manifest = 1;
+	}
+	if ( fd < 0 || !(f = fdopen(fd, "r")) ) {
+		if ( fd >= 0 )
+			close(fd);
+		goto bail;
+	}
+
+	LOCK();
+	if ( 0 == (listed = pfStats.listed) )
+		rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &pfStats.t_start );
+	pfScan(f, dir, manifest);
+	n = pfStats.listed - listed;
+	UNLOCK();
+
+	fclose(f);
+
+	printf("Prefetching %i module%s listed in '%s'\n", n, 1 == n ? "" : "s", path);
+
+	for ( i = 0; i < PREFETCH_TASKS && i < n; i++ ) {
+		LOCK();
+		if ( pfTasks >= PREFETCH_TASKS ) {
+			UNLOCK();
+			break;
+		}
+		pfTasks++;
+		UNLOCK();
+		sc = rtems_task_create(
+				rtems_build_name('P','F','T','0' + (pfSeq++ % 10)),
+				PREFETCH_PRIO,
+				4*RTEMS_MINIMUM_STACK_SIZE,
+				RTEMS_DEFAULT_MODES,
+				RTEMS_FLOATING_POINT | RTEMS_LOCAL,
+				&tid);
+		if ( RTEMS_SUCCESSFUL == sc ) {
+			sc = rtems_task_start( tid, pfTask, 0 );
+			if ( RTEMS_SUCCESSFUL != sc )
+				rtems_task_delete( tid );
+		}
+		if ( RTEMS_SUCCESSFUL != sc ) {
+			/* modules not fetched are loaded normally */
+			fprintf(stderr,"gesysPrefetch: unable to start task (%s)\n", rtems_status_text(sc));
+			LOCK();
+			pfTasks--;
+			UNLOCK();
+			break;
+		}
+	}
+
+bail:
+	free(path);
+	free(pdir);
+	return n;
+}
+
+/* Remove the entry for 'file' from the list; if it is being
+ * transferred wait for it.
+ *
+ * RETURNS: entry (with status PF_DONE or PF_FAILED) or NULL.
+ */
+static PrefetchEnt
+pfClaim(const char *file)
+{
+PrefetchEnt e;
+
+	if ( !pfLock || !file )
+		return 0;
+
+	LOCK();
+	for ( e = pfList; e && strcmp(e->name, file); e = e->next )
+		;
+	if ( e ) {
+		while ( PF_BUSY == e->status )
+			pfWait();
+		pfUnlink(e);
+		/* tasks may fetch ahead again */
+		pfWakeup();
+		if ( PF_QUEUED == e->status ) {
+			/* no task got to it yet; load it directly */
+			pfEntFree(e);
+			e = 0;
+		}
+	}
+	UNLOCK();
+	return e;
+}
+
+void *
+__wrap_cexpModuleLoad(char *file, char *name)
+{
+PrefetchEnt           e;
+void                  *rval = 0;
+char                  tmp[40];
+int                   loaded = 0;
+unsigned              seq;
+rtems_interrupt_level l;
+
+	if ( (e = pfClaim(file)) && PF_DONE == e->status ) {
+		rtems_interrupt_disable(l);
+		seq = pfFileSeq++;
+		rtems_interrupt_enable(l);
+		sprintf(tmp, "/tmp/prefetch%u.obj", seq);
+		if ( 0 == memFileCreate(tmp, e->data, e->len, 1) ) {
+			/* memFile owns the data now */
+			e->data = 0;
+			rval    = __real_cexpModuleLoad(tmp, name ? name : file);
+			loaded  = 1;
+			memFileRelease(tmp);
+			if ( !rval ) {
+				/* Cexp's error messages refer to the memFile */
+				fprintf(stderr,"gesysPrefetch: loading '%s' (prefetched as '%s') failed\n", file, tmp);
+			}
+			LOCK();
+			pfStats.hits++;
+			UNLOCK();
+		}
+	}
+	if ( e )
+		pfEntFree(e);
+
+	if ( !loaded )
+		rval = __real_cexpModuleLoad(file, name);
+
+	if ( rval && file && symProfRecord )
+		symProfRecord(file);
+
+	return rval;
+}
+
+/* Release modules which were prefetched but not loaded (waiting
+ * for transfers in progress) and print statistics.
+ */
+void
+gesysPrefetchFlush()
+{
+PrefetchEnt    e;
+rtems_interval now, tps;
+unsigned       unused = 0;
+
+	if ( !pfLock )
+		return;
+
+	LOCK();
+	while ( pfList ) {
+		for ( e = pfList; e && PF_BUSY == e->status; e = e->next )
+			;
+		if ( !e ) {
+			pfWait();
+			continue;
+		}
+		pfUnlink(e);
+		pfEntFree(e);
+		unused++;
+	}
+	/* let tasks waiting for room terminate */
+	pfWakeup();
+	UNLOCK();
+
+	if ( 0 == pfStats.listed )
+		return;
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &now );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+	printf("Prefetch: %u listed, %u fetched (%lu bytes), %u failed, %u loaded from cache, %u unused (%lums)\n",
+		pfStats.listed, pfStats.fetched, pfStats.bytes, pfStats.failed, pfStats.hits, unused,
+		(unsigned long)(now - pfStats.t_start) * 1000UL / tps);
+	memset(&pfStats, 0, sizeof(pfStats));
+}
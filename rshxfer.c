@@ -0,0 +1,421 @@
+/* Transfer engine for RSH downloads
+ *
+ * Reads the data and stderr streams of an RSH connection.
+ * Data are accumulated in a single growable buffer (obtained
+ * from memFileRealloc() so it can be exposed as a file without
+ * copying); stderr is forwarded to the console.
+ *
+ * Compared to a 'one read() per select()' loop the engine
+ *  - enlarges the socket receive buffer (rshXferRcvBuf) so the
+ *    sender is not throttled by the TCP window (see the limitation
+ *    noted below),
+ *  - puts the sockets into non-blocking mode and drains all
+ *    data that are ready on every wakeup,
+ *  - reads directly into the destination buffer.
+ *
+ * Counters of the most recent transfer can be printed with
+ * rshXferStats().
+ *
+ * Host benchmark: compile with -DDEBUG_MAIN; the program forks
+ * a local stand-in for rshd and reports MB/s, e.g.,
+ *
+ *   cc -DDEBUG_MAIN -O2 -o rshxfer rshxfer.c
+ *   ./rshxfer -s 1 -s 10 -s 50
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+
+#ifndef DEBUG_MAIN
+void *
+memFileRealloc(void *data, size_t len);
+#else
+#define memFileRealloc(p,l)	realloc((p),(l))
+#define memFileFree(p)		free(p)
+#endif
+
+/* Tunables (may be changed from the Cexp shell) */
+
+/* socket receive buffer size; 0 leaves the system default.
+ * NOTE: rcmd() creates and connects the socket, so the buffer
+ * can only be enlarged after the handshake. The TCP window
+ * scale has been agreed at that point (from the default buffer
+ * size), i.e., the advertised window stays below 64k unless the
+ * default is large enough to negotiate scaling already (e.g.,
+ * via rtems_bsdnet_config.tcp_rx_buf_size). The larger buffer
+ * still lets the stack queue more data while the reader is
+ * busy, but the sender is not allowed more than 64k in flight.
+ */
+int    rshXferRcvBuf    = 256*1024;
+/* max. bytes per read() */
+int    rshXferChunk     = 64*1024;
+/* read until EAGAIN on every wakeup; if zero then do
+ * only one read per wakeup (legacy behavior)
+ */
+int    rshXferDrain     = 1;
+/* give up if nothing arrives for this many seconds */
+int    rshXferTimeout   = 5;
+
+#define RSH_XFER_INITIAL	(64*1024)
+
+typedef struct RshXferStatsRec_ {
+	unsigned long	dataBytes;
+	unsigned long	errBytes;
+	unsigned long	wakeups;
+	unsigned long	reads;
+	unsigned long	grows;
+	unsigned long	peakCap;
+	unsigned long	firstUs;	/* latency to first data byte */
+	unsigned long	maxGapUs;	/* longest wait in select()   */
+	unsigned long	totalUs;
+} RshXferStatsRec, *RshXferStats;
+
+static RshXferStatsRec rshXferLast;
+
+static unsigned long
+usSince(struct timeval *then)
+{
+struct timeval now;
+	gettimeofday(&now, 0);
+	return (now.tv_sec - then->tv_sec) * 1000000UL + now.tv_usec - then->tv_usec;
+}
+
+static void
+setNonBlocking(int fd)
+{
+int fl;
+	if ( (fl = fcntl(fd, F_GETFL, 0)) >= 0 )
+		fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+/* Read everything available on '*pfd'; closes '*pfd' and sets it
+ * to -1 on EOF. If 'pData' is NULL then data are written to 'out'.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+static int
+drain(int *pfd, char **pData, size_t *pLen, size_t *pCap, int out, RshXferStats st)
+{
+char   buf[BUFSIZ];
+char   *dst, *nbuf;
+size_t avail, ncap;
+int    got, put;
+
+	do {
+		if ( pData && *pCap > *pLen ) {
+			dst   = *pData + *pLen;
+			avail = *pCap - *pLen;
+			if ( avail > (size_t)rshXferChunk )
+				avail = rshXferChunk;
+		} else {
+			/* if the data buffer is full then read into 'buf' first
+			 * so we don't grow it just to find EOF.
+			 */
+			dst   = buf;
+			avail = sizeof(buf);
+		}
+
+		got = read(*pfd, dst, avail);
+
+		if ( got < 0 ) {
+			if ( EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno )
+				return 0;
+			perror("rshXfer(): read");
+			return -1;
+		}
+
+		if ( pData && got > 0 && dst == buf ) {
+			ncap = *pCap ? 2 * *pCap : RSH_XFER_INITIAL;
+			if ( !(nbuf = memFileRealloc(*pData, ncap)) ) {
+				fprintf(stderr,"rshXfer(): unable to grow buffer to %lu bytes\n", (unsigned long)ncap);
+				return -1;
+			}
+			*pData = nbuf;
+			*pCap  = ncap;
+			st->grows++;
+			if ( ncap > st->peakCap )
+				st->peakCap = ncap;
+			memcpy(*pData + *pLen, buf, got);
+		}
+
+		st->reads++;
+
+		if ( 0 == got ) {
+			close(*pfd);
+			*pfd = -1;
+			return 0;
+		}
+
+		if ( pData ) {
+			if ( 0 == st->dataBytes )
+				st->firstUs = st->totalUs;
+			*pLen         += got;
+			st->dataBytes += got;
+		} else {
+			st->errBytes += got;
+			for ( ; got > 0; got -= put, dst += put ) {
+				if ( (put = write(out, dst, got)) <= 0 )
+					break;
+			}
+		}
+	} while ( rshXferDrain );
+
+	return 0;
+}
+
+/* Transfer the data stream 'fd' into a buffer and copy the
+ * error stream 'ed' (may be -1) to stderr. Both descriptors
+ * are closed. '*pData' must be NULL or obtained from
+ * memFileAlloc()/memFileRealloc() with capacity '*pCap'; it
+ * is grown as needed and the number of bytes received is
+ * stored in '*pLen'.
+ *
+ * RETURNS: 0 on success, -1 on error (the buffer is left
+ *          to the caller in either case).
+ */
+int
+rshXfer(int fd, int ed, char **pData, size_t *pLen, size_t *pCap)
+{
+RshXferStatsRec st;
+struct timeval  t0, tsel, timeout;
+fd_set          r;
+int             maxfd, got;
+unsigned long   gap;
+int             rval = -1;
+
+	memset(&st, 0, sizeof(st));
+	st.peakCap = *pCap;
+	*pLen      = 0;
+
+	gettimeofday(&t0, 0);
+
+	if ( rshXferRcvBuf > 0 ) {
+		if ( setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rshXferRcvBuf, sizeof(rshXferRcvBuf)) )
+			perror("rshXfer(): setting SO_RCVBUF (ignored)");
+	}
+	setNonBlocking(fd);
+	if ( ed >= 0 )
+		setNonBlocking(ed);
+
+	while ( fd >= 0 || ed >= 0 ) {
+		FD_ZERO( &r );
+		maxfd = -1;
+		if ( fd >= 0 ) {
+			FD_SET( fd, &r );
+			maxfd = fd;
+		}
+		if ( ed >= 0 ) {
+			FD_SET( ed, &r );
+			if ( ed > maxfd )
+				maxfd = ed;
+		}
+
+		timeout.tv_sec  = rshXferTimeout;
+		timeout.tv_usec = 0;
+
+		gettimeofday(&tsel, 0);
+		got = select(maxfd + 1, &r, 0, 0, &timeout);
+		if ( (gap = usSince(&tsel)) > st.maxGapUs )
+			st.maxGapUs = gap;
+
+		if ( got <= 0 ) {
+			if ( got ) {
+				if ( EINTR == errno )
+					continue;
+				perror("rshXfer(): select() error");
+			} else {
+				fprintf(stderr,"rshXfer(): select() timeout\n");
+			}
+			goto cleanup;
+		}
+
+		st.wakeups++;
+		st.totalUs = usSince(&t0);
+
+		if ( ed >= 0 && FD_ISSET( ed, &r ) ) {
+			if ( drain( &ed, 0, 0, 0, 2, &st ) )
+				goto cleanup;
+		}
+		if ( fd >= 0 && FD_ISSET( fd, &r ) ) {
+			if ( drain( &fd, pData, pLen, pCap, -1, &st ) )
+				goto cleanup;
+		}
+	}
+
+	rval = 0;
+
+cleanup:
+	if ( fd >= 0 )
+		close(fd);
+	if ( ed >= 0 )
+		close(ed);
+	st.totalUs  = usSince(&t0);
+	rshXferLast = st;
+	return rval;
+}
+
+/* Print counters of the most recent transfer */
+void
+rshXferStats()
+{
+RshXferStats  st = &rshXferLast;
+unsigned long ms = st->totalUs / 1000;
+
+	printf("RSH transfer: %lu data bytes, %lu stderr bytes in %lu.%03lus",
+		st->dataBytes, st->errBytes, ms / 1000, ms % 1000);
+	if ( st->totalUs )
+		printf(" (%lu kB/s)", (unsigned long)((unsigned long long)st->dataBytes * 1000 / 1024 * 1000 / st->totalUs));
+	printf("\n");
+	printf("  %lu wakeups, %lu reads, %lu buffer grows, peak buffer %lu bytes\n",
+		st->wakeups, st->reads, st->grows, st->peakCap);
+	printf("  first data after %luus, longest wait %luus\n",
+		st->firstUs, st->maxGapUs);
+	printf("  rshXferRcvBuf %i, rshXferChunk %i, rshXferDrain %i\n",
+		rshXferRcvBuf, rshXferChunk, rshXferDrain);
+}
+
+#ifdef DEBUG_MAIN
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Stand-in for rshd: accept a data and a stderr connection
+ * and send 'nbytes' of data (plus a short message on stderr).
+ */
+static void
+serve(int ls, unsigned long nbytes)
+{
+int           d, e, put;
+unsigned long i, n;
+static char   buf[64*1024];
+const char    *msg = "rshd stand-in: sending file\n";
+
+	if ( (d = accept(ls, 0, 0)) < 0 || (e = accept(ls, 0, 0)) < 0 ) {
+		perror("accept");
+		_exit(1);
+	}
+	for ( i = 0; i < sizeof(buf); i++ )
+		buf[i] = (char)(i * 7 + (i >> 8));
+	write(e, msg, strlen(msg));
+	close(e);
+	while ( nbytes > 0 ) {
+		n = nbytes < sizeof(buf) ? nbytes : sizeof(buf);
+		if ( (put = write(d, buf, n)) <= 0 ) {
+			perror("write");
+			_exit(1);
+		}
+		nbytes -= put;
+	}
+	close(d);
+	_exit(0);
+}
+
+static int
+conn(struct sockaddr_in *sa)
+{
+int s;
+	if ( (s = socket(AF_INET, SOCK_STREAM, 0)) < 0 || connect(s, (struct sockaddr*)sa, sizeof(*sa)) ) {
+		perror("connect");
+		exit(1);
+	}
+	return s;
+}
+
+static int
+bench(unsigned long mb)
+{
+struct sockaddr_in sa;
+socklen_t          salen = sizeof(sa);
+int                ls, fd, ed, st;
+pid_t              pid;
+char               *data = 0;
+size_t             len, cap = 0;
+unsigned long      nbytes = mb * 1024 * 1024;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family      = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ( (ls = socket(AF_INET, SOCK_STREAM, 0)) < 0
+	     || bind(ls, (struct sockaddr*)&sa, sizeof(sa))
+	     || listen(ls, 2)
+	     || getsockname(ls, (struct sockaddr*)&sa, &salen) ) {
+		perror("listening socket");
+		return -1;
+	}
+
+	if ( 0 == (pid = fork()) )
+		serve(ls, nbytes);
+	close(ls);
+
+	fd = conn(&sa);
+	ed = conn(&sa);
+
+	st = rshXfer(fd, ed, &data, &len, &cap);
+	waitpid(pid, 0, 0);
+
+	printf("%3lu MB: %s\n", mb, st ? "FAILED" : (len == nbytes ? "OK" : "SHORT"));
+	rshXferStats();
+	memFileFree(data);
+	return st || len != nbytes ? -1 : 0;
+}
+
+static void
+usage(char *nm)
+{
+	fprintf(stderr,"Usage: %s [-s <MB>]... [-b <rcvbuf>] [-c <chunk>] [-1]\n",nm);
+	fprintf(stderr,"       -s : file size in MB (may be repeated; default 1, 10, 50)\n");
+	fprintf(stderr,"       -b : SO_RCVBUF (0: system default)\n");
+	fprintf(stderr,"       -c : max. bytes per read()\n");
+	fprintf(stderr,"       -1 : one read per wakeup (legacy behavior)\n");
+}
+
+int main(int argc, char **argv)
+{
+unsigned long sizes[20];
+int           nsizes = 0, i, ch, rval = 0;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	while ( (ch = getopt(argc, argv, "s:b:c:1h")) > 0 ) {
+		switch ( ch ) {
+			case 's':
+				if ( nsizes < sizeof(sizes)/sizeof(sizes[0]) )
+					sizes[nsizes++] = strtoul(optarg, 0, 0);
+			break;
+			case 'b': rshXferRcvBuf = strtoul(optarg, 0, 0); break;
+			case 'c': rshXferChunk  = strtoul(optarg, 0, 0); break;
+			case '1':
+				rshXferDrain = 0;
+				rshXferChunk = BUFSIZ;
+			break;
+			default:
+				usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ( 0 == nsizes ) {
+		sizes[nsizes++] = 1;
+		sizes[nsizes++] = 10;
+		sizes[nsizes++] = 50;
+	}
+
+	for ( i = 0; i < nsizes; i++ ) {
+		if ( bench(sizes[i]) )
+			rval = 1;
+	}
+	return rval;
+}
+#endif
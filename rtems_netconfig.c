@@ -19,7 +19,8 @@
  *   LO_IF_ONLY               <undefined>   If defined, do NOT configure any ethernet driver but only the
  *                                          loopback interface.
  *   MULTI_NETDRIVER          <undefined>   ugly hack; if defined try to probe a variety of PCI and ISA drivers
- *                                          (i386 ONLY) use is discouraged!
+ *                                          (i386 ONLY) use is discouraged! The driver that worked is
+ *                                          remembered (NIC_HINT env. var or SYMCACHE) and tried first.
  *   NIC_NAME                 <undefined>   Ethernet driver name (e.g. "pcn1"); must also define NIC_ATTACH
  *   NIC_ATTACH               <undefined>   Ethernet driver attach function (e.g., rtems_fxp_attach).
  *                                          If these are undefined then
@@ -33,8 +34,12 @@
  *   MEMORY_HUGE              <undefined>   Allocate a lot of memory for mbufs (hint for how much memory the board has)
  *                                          If none of MEMORY_CUSTOM/MEMORY_SCARCE/MEMORY_HUGE are defined then a
  *                                          medium amount of memory is allocated for mbufs.
+ *                                          The sizes can be overridden at run-time by the environment
+ *                                          variables NET_MBUF_SPACE/NET_CLUSTER_SPACE (see init.c).
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <bsp.h>
 #include <rtems/rtems_bsdnet.h>
 
@@ -100,33 +105,106 @@ static struct rtems_bsdnet_ifconfig pci_netdriver_config[]={
 	},
 };
 
+/* The driver which worked is remembered so the next boot can try
+ * it first (probing some drivers, e.g., 3c90x, takes very long):
+ *  - the environment variable NIC_HINT=<name> (e.g., set in NVRAM
+ *    or on the command line) takes precedence;
+ *  - otherwise, the persistent symbol cache (SYMCACHE=<addr>:<len>,
+ *    see symcache.c) is consulted and updated.
+ * If the hinted driver fails, all drivers are probed.
+ */
+#define NIC_HINT_KEY	"#nic-hint"
+
+extern int   symCacheAttachFromEnv();
+extern void *symCacheLookup(const char *key, unsigned long *plen);
+extern void *symCachePut(const char *key, const void *data, unsigned long len);
+
+static const char *
+nicHintGet(int *fromCache)
+{
+const char    *hint;
+unsigned long len;
+
+	*fromCache = 0;
+	if ( (hint = getenv("NIC_HINT")) && *hint )
+		return hint;
+
+	/* normally attached later by Init(); no-op if already done */
+	if ( symCacheAttachFromEnv() )
+		return 0;
+	if ( (hint = symCacheLookup(NIC_HINT_KEY, &len)) && len > 0 && !hint[len-1] ) {
+		*fromCache = 1;
+		return hint;
+	}
+	return 0;
+}
+
+/* RETURNS: 0 if the driver seems to have attached an interface */
+static int
+nicProbe(struct rtems_bsdnet_ifconfig *cfg, int attaching)
+{
+int            if_index_pre;
+extern int     if_index;
+rtems_interval t0, t1, tps;
+
+	printf("Probing '%s'", cfg->name); fflush(stdout);
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+	/* unfortunately, the return value is unreliable - some drivers report
+	 * success even if they fail.
+	 * Check if they chained an interface (ifnet) structure instead
+	 */
+	if_index_pre = if_index;
+	cfg->attach(cfg, attaching);
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+	if ( if_index > if_index_pre) {
+		/* assume success */
+		printf(" .. seemed to work (%lums)\n", (unsigned long)(t1 - t0) * 1000UL / tps);
+		return 0;
+	}
+	printf(" .. failed (%lums)\n", (unsigned long)(t1 - t0) * 1000UL / tps);
+	return -1;
+}
+
 static int pci_check(struct rtems_bsdnet_ifconfig *ocfg, int attaching)
 {
-struct rtems_bsdnet_ifconfig *cfg;
-int if_index_pre;
-extern int if_index;
+struct rtems_bsdnet_ifconfig *cfg = 0, *hinted = 0;
+const char                   *hint;
+int                          fromCache;
+
 	if ( attaching ) {
 		cfg = pcib_init() ? isa_netdriver_config : pci_netdriver_config;
 	}
-	while ( cfg ) {
-		printf("Probing '%s'", cfg->name); fflush(stdout);
-		/* unfortunately, the return value is unreliable - some drivers report
-		 * success even if they fail.
-		 * Check if they chained an interface (ifnet) structure instead
-		 */
-		if_index_pre = if_index;
-		cfg->attach(cfg, attaching);
-		if ( if_index > if_index_pre) {
-			/* assume success */
-			printf(" .. seemed to work\n");
-			ocfg->name   = cfg->name;
-			ocfg->attach = cfg->attach;
-			return 0;
+
+	/* nothing to probe unless attaching */
+	if ( attaching && (hint = nicHintGet(&fromCache)) ) {
+		for ( hinted = cfg; hinted && strcmp(hinted->name, hint); hinted = hinted->next )
+			;
+		if ( hinted ) {
+			printf("Trying '%s' first (NIC_HINT from %s)\n", hint, fromCache ? "symbol cache" : "environment");
+			if ( 0 == nicProbe(hinted, attaching) )
+				goto found;
+		} else {
+			fprintf(stderr,"NIC_HINT: unknown driver '%s'; ignored\n", hint);
+		}
+	}
+
+	for ( ; cfg; cfg = cfg->next ) {
+		if ( cfg == hinted )
+			continue;
+		if ( 0 == nicProbe(cfg, attaching) ) {
+			if ( !symCachePut(NIC_HINT_KEY, cfg->name, strlen(cfg->name) + 1) )
+				printf("(set NIC_HINT=%s in the boot environment to skip probing next time)\n", cfg->name);
+			hinted = cfg;
+			goto found;
 		}
-		printf(" .. failed\n");
-		cfg = cfg->next;
 	}
 	return -1;
+
+found:
+	ocfg->name   = hinted->name;
+	ocfg->attach = hinted->attach;
+	return 0;
 }
 
 #define NIC_NAME   "dummy"
@@ -220,3 +298,15 @@ gesys_set_netdriver(char *name, int (*attach_fn)(struct rtems_bsdnet_ifconfig *,
 	}
 	return -1;
 }
+
+/* Override the mbuf/cluster pool sizes (bytes; 0 leaves a value
+ * unchanged). Must be called before rtems_bsdnet_initialize_network().
+ */
+void
+gesys_set_mbuf_space(unsigned long mbuf_bytes, unsigned long cluster_bytes)
+{
+	if ( mbuf_bytes )
+		rtems_bsdnet_config.mbuf_bytecount         = mbuf_bytes;
+	if ( cluster_bytes )
+		rtems_bsdnet_config.mbuf_cluster_bytecount = cluster_bytes;
+}
@@ -0,0 +1,127 @@
+/* Periodic sampler task
+ *
+ * Statistics which are only meaningful as peaks over time
+ * (mbstats.c, objreport.c) take their samples from a low-
+ * priority task. A sampler is created once
+ *
+ *   s = gesysSamplerCreate("mbufStatsStart", name, prio, sample);
+ *
+ * and gesysSamplerStart(s, period_ms) spawns a task which calls
+ * 'sample()' every 'period_ms' milliseconds (or changes the period
+ * if it is running already). gesysSamplerStop() makes the task
+ * terminate at the end of the current period.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct SamplerRec_ {
+	const char		*who;		/* for messages */
+	rtems_name		name;
+	rtems_task_priority	prio;
+	void			(*sample)();
+	volatile int	period;		/* ms; 0 stops the task */
+	rtems_id		tid;		/* 0 when not running   */
+} SamplerRec, *Sampler;
+
+static rtems_task
+samplerTask(rtems_task_argument arg)
+{
+Sampler        s = (Sampler)arg;
+rtems_interval tps, ticks;
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	while ( s->period > 0 ) {
+		s->sample();
+		if ( (ticks = s->period * tps / 1000) < 1 )
+			ticks = 1;
+		rtems_task_wake_after( ticks );
+	}
+	s->tid = 0;
+	rtems_task_delete( RTEMS_SELF );
+}
+
+/* Create a (stopped) sampler; 'who' is used in messages.
+ *
+ * RETURNS: handle or NULL (no memory).
+ */
+void *
+gesysSamplerCreate(const char *who, rtems_name name, rtems_task_priority prio, void (*sample)())
+{
+Sampler s;
+
+	if ( !(s = calloc(1, sizeof(*s))) ) {
+		fprintf(stderr,"%s(): no memory for sampler\n", who);
+		return 0;
+	}
+	s->who    = who;
+	s->name   = name;
+	s->prio   = prio;
+	s->sample = sample;
+	return s;
+}
+
+/* Start sampling every 'period_ms' milliseconds (changes the
+ * period if already running).
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+gesysSamplerStart(void *h, int period_ms)
+{
+Sampler           s = h;
+rtems_status_code sc;
+rtems_id          tid;
+
+	if ( period_ms <= 0 ) {
+		fprintf(stderr,"%s(): need period > 0 (ms)\n", s->who);
+		return -1;
+	}
+
+	s->period = period_ms;
+
+	if ( s->tid )
+		return 0;
+
+	sc = rtems_task_create(
+			s->name,
+			s->prio,
+			RTEMS_MINIMUM_STACK_SIZE + 1024,
+			RTEMS_DEFAULT_MODES,
+			RTEMS_DEFAULT_ATTRIBUTES,
+			&tid);
+	if ( RTEMS_SUCCESSFUL == sc ) {
+		s->tid = tid;
+		sc = rtems_task_start( tid, samplerTask, (rtems_task_argument)s );
+		if ( RTEMS_SUCCESSFUL != sc ) {
+			rtems_task_delete( tid );
+			s->tid = 0;
+		}
+	}
+	if ( RTEMS_SUCCESSFUL != sc ) {
+		fprintf(stderr,"%s(): unable to spawn sampler task (%s)\n", s->who, rtems_status_text(sc));
+		return -1;
+	}
+	return 0;
+}
+
+/* Stop the sampler (it terminates at the end of the current period) */
+void
+gesysSamplerStop(void *h)
+{
+Sampler s = h;
+	s->period = 0;
+}
+
+/* RETURNS: nonzero if the sampler task is running */
+int
+gesysSamplerRunning(void *h)
+{
+Sampler s = h;
+	return 0 != s->tid;
+}
@@ -0,0 +1,502 @@
+/* Persistent cache for the symbol file and the system script
+ *
+ * A memory area which survives a warm reboot (e.g., a reserved
+ * RAM area or NVRAM which is not cleared by the BSP or the
+ * bootloader) may be designated by the environment variable
+ *
+ *   SYMCACHE=<address>:<length>
+ *
+ * (same syntax as TARFS). The cache holds a few files keyed by
+ * their path; each entry records the file size, modification time
+ * (if the filesystem provides it) and an Adler-32 checksum of the
+ * contents.
+ *
+ * When Init() opens the symbol file or the system script it
+ * consults the cache: if the remote file's size and modification
+ * time (as reported by fstat) match an entry whose checksum is
+ * still intact, the transfer is skipped and the cached copy is
+ * exposed as a read-only file in /tmp (without copying, see
+ * memfile.c). Otherwise, the file is read once into the cache
+ * and exposed the same way.
+ *
+ * NOTES: TFTP cannot report file size nor modification time;
+ *        files on TFTP are always transferred (but the cache is
+ *        kept up to date).
+ *        Entries which have been exposed as files during the
+ *        current boot are never overwritten. When the area is full
+ *        the entries following them are discarded; if the file
+ *        still doesn't fit it is copied into a (non-persistent)
+ *        memFile instead.
+ *
+ * From the Cexp shell, use symCacheShow() and symCacheFlush().
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "verscheck.h"
+
+/* from memfile.c */
+#define MEMFILE_HDR_SIZE	512
+#define MEMFILE_PADDED(l)	(((l) + MEMFILE_HDR_SIZE - 1) & ~(MEMFILE_HDR_SIZE - 1))
+int memFileCreate(const char *path, void *data, size_t len, int owned);
+void *memFileAlloc(size_t len);
+void *memFileRealloc(void *data, size_t len);
+void memFileFree(void *data);
+
+#define SYMCACHE_MAGIC		0x47535943	/* 'GSYC' */
+#define SYMCACHE_ENT_MAGIC	0x47534345	/* 'GSCE' */
+#define SYMCACHE_VERSION	1
+
+#define SYMCACHE_KEYLEN		200
+
+/* Cache layout:
+ *
+ *   SymCacheHdrRec
+ *   entry 0:  SymCacheEntRec  (padded to MEMFILE_HDR_SIZE)
+ *             MEMFILE_HDR_SIZE bytes reserved for memfile.c
+ *             data padded to MEMFILE_HDR_SIZE
+ *   entry 1:  ...
+ */
+typedef struct SymCacheHdrRec_ {
+	unsigned long	magic;
+	unsigned long	version;
+	unsigned long	size;		/* total size of area                */
+	unsigned long	used;		/* offset of first free byte         */
+} SymCacheHdrRec, *SymCacheHdr;
+
+typedef struct SymCacheEntRec_ {
+	unsigned long	magic;
+	unsigned long	len;		/* data length                       */
+	unsigned long	mtime;		/* 0 if unknown                      */
+	unsigned long	cksum;		/* Adler-32 of data                  */
+	char		key[SYMCACHE_KEYLEN];
+} SymCacheEntRec, *SymCacheEnt;
+
+#define ENT_HDR_SIZE		MEMFILE_PADDED(sizeof(SymCacheEntRec))
+#define ENT_DATA(e)		((char*)(e) + ENT_HDR_SIZE + MEMFILE_HDR_SIZE)
+#define ENT_SIZE(len)		(ENT_HDR_SIZE + MEMFILE_HDR_SIZE + MEMFILE_PADDED(len))
+#define FIRST_ENT(h)		(MEMFILE_PADDED(sizeof(*(h))))
+
+static SymCacheHdr	theCache = 0;
+static unsigned		nCacheFiles = 0;
+/* end of the last entry exposed as a file during this boot;
+ * nothing below may be reclaimed or overwritten
+ */
+static unsigned long	pinnedEnd = 0;
+
+/* Adler-32 (RFC 1950) */
+unsigned long
+symCacheCksum(unsigned long adler, const void *buf, unsigned long len)
+{
+const unsigned char *p = buf;
+unsigned long        a = adler & 0xffff, b = (adler >> 16) & 0xffff;
+unsigned             n;
+
+	while ( len > 0 ) {
+		/* 5552 is the largest n such that no overflow occurs */
+		n    = len > 5552 ? 5552 : len;
+		len -= n;
+		while ( n-- ) {
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static void
+symCacheFormat(SymCacheHdr h, unsigned long size)
+{
+	h->magic   = SYMCACHE_MAGIC;
+	h->version = SYMCACHE_VERSION;
+	h->size    = size;
+	h->used    = FIRST_ENT(h);
+}
+
+/* Discard all entries which are not (and don't precede) files
+ * exposed during this boot.
+ */
+static void
+symCacheTrim()
+{
+	if ( pinnedEnd )
+		theCache->used = pinnedEnd;
+	else
+		symCacheFormat(theCache, theCache->size);
+}
+
+/* Attach the cache to 'len' bytes at 'addr'; existing contents
+ * are preserved if they look valid.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+int
+symCacheInit(void *addr, unsigned long len)
+{
+SymCacheHdr h = addr;
+
+	if ( !h || ((unsigned long)h & (sizeof(long) - 1)) || len < FIRST_ENT(h) + ENT_SIZE(0) ) {
+		fprintf(stderr,"symCacheInit(): invalid/misaligned area or too small\n");
+		return -1;
+	}
+
+	if (   SYMCACHE_MAGIC   != h->magic
+	    || SYMCACHE_VERSION != h->version
+	    || len              != h->size
+	    || h->used          <  FIRST_ENT(h)
+	    || h->used          >  len ) {
+		printf("Symbol cache @%p[%lu]: no valid contents; formatting\n", addr, len);
+		symCacheFormat(h, len);
+	} else {
+		printf("Symbol cache @%p[%lu]: %lu bytes used\n", addr, len, h->used);
+	}
+	theCache = h;
+	return 0;
+}
+
+/* Attach the cache to the area defined by the 'SYMCACHE'
+ * environment variable (no-op if already attached or if
+ * the variable is undefined).
+ */
+int
+symCacheAttachFromEnv()
+{
+char *var;
+void *addr;
+int   len;
+
+	if ( theCache )
+		return 0;
+	if ( !(var = getenv("SYMCACHE")) )
+		return -1;
+	if ( 2 != sscanf(var, "%p:%i", &addr, &len) || len <= 0 ) {
+		fprintf(stderr,"SYMCACHE: invalid value '%s' (expected <addr>:<len>)\n", var);
+		return -1;
+	}
+	return symCacheInit(addr, len);
+}
+
+/* RETURNS: nonzero if a cache area is attached */
+int
+symCacheAttached()
+{
+	return 0 != theCache;
+}
+
+/* Visit all entries; the callback returns nonzero to stop */
+static SymCacheEnt
+symCacheWalk(int (*cb)(SymCacheEnt, void *), void *arg)
+{
+unsigned long off;
+SymCacheEnt   e;
+
+	if ( !theCache )
+		return 0;
+
+	for ( off = FIRST_ENT(theCache); off < theCache->used; off += ENT_SIZE(e->len) ) {
+		e = (SymCacheEnt)((char*)theCache + off);
+		if ( SYMCACHE_ENT_MAGIC != e->magic || off + ENT_SIZE(e->len) > theCache->used ) {
+			/* corrupted; discard this and all following entries */
+			fprintf(stderr,"Symbol cache: corrupted entry @%p; truncating\n", e);
+			theCache->used = off;
+			break;
+		}
+		if ( cb(e, arg) )
+			return e;
+	}
+	return 0;
+}
+
+static int
+keyMatch(SymCacheEnt e, void *key)
+{
+	return 0 == strcmp(e->key, (char*)key);
+}
+
+/* Find an entry; returns pointer to the data and stores
+ * the length in *plen. The entry's checksum is verified.
+ */
+void *
+symCacheLookup(const char *key, unsigned long *plen)
+{
+SymCacheEnt e;
+
+	if ( !(e = symCacheWalk(keyMatch, (void*)key)) )
+		return 0;
+	if ( symCacheCksum(1, ENT_DATA(e), e->len) != e->cksum ) {
+		fprintf(stderr,"Symbol cache: checksum mismatch for '%s'\n", key);
+		return 0;
+	}
+	if ( plen )
+		*plen = e->len;
+	return ENT_DATA(e);
+}
+
+/* Mark an entry as stale. Since entries are kept in a log
+ * we can only reclaim the space if it is the last one (and
+ * not exposed as a file).
+ */
+static void
+symCacheDrop(SymCacheEnt e)
+{
+	if (   (char*)e + ENT_SIZE(e->len) == (char*)theCache + theCache->used
+	    && (unsigned long)((char*)e - (char*)theCache) >= pinnedEnd ) {
+		theCache->used = (char*)e - (char*)theCache;
+	} else {
+		/* invalidate key */
+		e->key[0] = 0;
+	}
+}
+
+/* Reserve a new entry for up to 'maxlen' bytes; existing
+ * entries for the same key are dropped. The entry is not
+ * valid until symCacheCommit() is called.
+ */
+static SymCacheEnt
+symCacheReserve(const char *key, unsigned long maxlen)
+{
+SymCacheEnt e;
+
+	if ( !theCache || strlen(key) >= SYMCACHE_KEYLEN )
+		return 0;
+
+	if ( (e = symCacheWalk(keyMatch, (void*)key)) )
+		symCacheDrop(e);
+
+	if ( theCache->used + ENT_SIZE(maxlen) > theCache->size ) {
+		/* discard what we may and try again */
+		symCacheTrim();
+		if ( theCache->used + ENT_SIZE(maxlen) > theCache->size )
+			return 0;
+	}
+
+	e = (SymCacheEnt)((char*)theCache + theCache->used);
+	memset(e, 0, sizeof(*e));
+	strcpy(e->key, key);
+	return e;
+}
+
+static void
+symCacheCommit(SymCacheEnt e, unsigned long len, unsigned long mtime)
+{
+	e->len   = len;
+	e->mtime = mtime;
+	e->cksum = symCacheCksum(1, ENT_DATA(e), len);
+	e->magic = SYMCACHE_ENT_MAGIC;
+	theCache->used += ENT_SIZE(len);
+}
+
+/* Store 'len' bytes under 'key'.
+ *
+ * RETURNS: pointer to cached copy or NULL (no cache, no space).
+ */
+void *
+symCachePut(const char *key, const void *data, unsigned long len)
+{
+SymCacheEnt e;
+	if ( !(e = symCacheReserve(key, len)) )
+		return 0;
+	memcpy(ENT_DATA(e), data, len);
+	symCacheCommit(e, len, 0);
+	return ENT_DATA(e);
+}
+
+static int
+symCacheExpose(SymCacheEnt e, char **pFnam)
+{
+char nam[30];
+
+unsigned long end = (char*)e + ENT_SIZE(e->len) - (char*)theCache;
+
+	sprintf(nam, "/tmp/symcache%u", nCacheFiles++);
+	if ( memFileCreate(nam, ENT_DATA(e), e->len, 0) )
+		return -1;
+	if ( end > pinnedEnd )
+		pinnedEnd = end;
+	*pFnam = strdup(nam);
+	return 0;
+}
+
+/* The file doesn't fit into the cache; copy the 'len' bytes
+ * already read to 'buf' (may be NULL), the byte at 'pc' (if
+ * non-NULL) and the rest of 'fd' into a memFile.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+static int
+symCacheCopy(const char *key, int fd, const void *buf, unsigned long len, const char *pc, char **pFnam)
+{
+char          nam[30];
+char          *data, *nbuf;
+unsigned long cap = len + 65536;
+int           got;
+
+	if ( !(data = memFileAlloc(cap)) )
+		return -1;
+	if ( len )
+		memcpy(data, buf, len);
+	if ( pc )
+		data[len++] = *pc;
+	while ( (got = read(fd, data + len, cap - len)) > 0 ) {
+		len += got;
+		if ( len == cap ) {
+			if ( !(nbuf = memFileRealloc(data, 2*cap)) )
+				goto bail;
+			data = nbuf;
+			cap *= 2;
+		}
+	}
+	if ( got < 0 ) {
+		fprintf(stderr,"Symbol cache: reading '%s' failed: %s\n", key, strerror(errno));
+		goto bail;
+	}
+	sprintf(nam, "/tmp/symcache%u", nCacheFiles++);
+	if ( memFileCreate(nam, data, len, 1) )
+		goto bail;
+	*pFnam = strdup(nam);
+	printf("Symbol cache: '%s' doesn't fit; not cached (%lu bytes)\n", key, len);
+	return 0;
+
+bail:
+	memFileFree(data);
+	return -1;
+}
+
+/* Read everything from 'fd' into a new entry ('size_hint'
+ * is the expected size if known, zero otherwise). If it
+ * doesn't fit the contents are copied into a memFile (*pFnam)
+ * instead and NULL is returned; *pFnam is left alone on errors.
+ */
+static SymCacheEnt
+symCacheFill(const char *key, int fd, unsigned long size_hint, unsigned long mtime, char **pFnam)
+{
+SymCacheEnt   e;
+unsigned long avail, len;
+int           got;
+
+	if ( !(e = symCacheReserve(key, size_hint)) ) {
+		symCacheCopy(key, fd, 0, 0, 0, pFnam);
+		return 0;
+	}
+
+	/* data are padded to MEMFILE_HDR_SIZE */
+	avail = (theCache->size - theCache->used - ENT_SIZE(0)) & ~(MEMFILE_HDR_SIZE - 1);
+
+	/* read(fd, ..., 0) would look like an empty file */
+	if ( 0 == avail || avail < size_hint ) {
+		symCacheCopy(key, fd, 0, 0, 0, pFnam);
+		return 0;
+	}
+
+	for ( len = 0; (got = read(fd, ENT_DATA(e) + len, avail - len)) > 0; ) {
+		len += got;
+		if ( len >= avail ) {
+			/* file may be larger than the available space; check */
+			char c;
+			if ( (got = read(fd, &c, 1)) > 0 ) {
+				/* ENT_DATA(e) is not committed; copy it out */
+				symCacheCopy(key, fd, ENT_DATA(e), len, &c, pFnam);
+				return 0;
+			}
+			break;
+		}
+	}
+	if ( got < 0 ) {
+		fprintf(stderr,"Symbol cache: reading '%s' failed: %s\n", key, strerror(errno));
+		return 0;
+	}
+
+	symCacheCommit(e, len, mtime);
+	return e;
+}
+
+/* Consult the cache for file 'key' which has been opened ('fd').
+ *
+ * On success, a (malloced) path of a file in /tmp holding the
+ * contents is returned in *pFnam; the caller should close 'fd'
+ * and use *pFnam instead.
+ *
+ * RETURNS: 1 on cache hit, 0 if the file was read into the cache,
+ *          -1 if the cache could not be used. Note that the
+ *          contents of 'fd' may have been consumed in this case;
+ *          the caller must reopen the file.
+ */
+int
+symCacheGet(const char *key, int fd, char **pFnam)
+{
+struct stat   st;
+unsigned long len = 0, mtime = 0;
+SymCacheEnt   e;
+rtems_interval t0, t1, tps;
+
+	if ( !theCache )
+		return -1;
+
+	if ( 0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 ) {
+		len   = st.st_size;
+		mtime = st.st_mtime;
+
+		if (   (e = symCacheWalk(keyMatch, (void*)key))
+		    && e->len   == len
+		    && e->mtime == mtime
+		    && symCacheCksum(1, ENT_DATA(e), e->len) == e->cksum ) {
+			if ( symCacheExpose(e, pFnam) )
+				return -1;
+			printf("Symbol cache: HIT '%s' (%lu bytes)\n", key, len);
+			return 1;
+		}
+	}
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+	if ( !(e = symCacheFill(key, fd, len, mtime, pFnam)) )
+		return *pFnam ? 0 : -1;
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	if ( symCacheExpose(e, pFnam) )
+		return -1;
+
+	printf("Symbol cache: MISS '%s' (%lu bytes transferred in %lu ms)\n",
+		key, e->len, (unsigned long)(t1 - t0) * 1000UL / tps);
+	return 0;
+}
+
+static int
+entShow(SymCacheEnt e, void *unused)
+{
+	printf("  %8lu  0x%08lx  %10lu  %s\n", e->len, e->cksum, e->mtime, e->key[0] ? e->key : "<stale>");
+	return 0;
+}
+
+/* Print the cache contents */
+void
+symCacheShow()
+{
+	if ( !theCache ) {
+		printf("Symbol cache not attached (set SYMCACHE=<addr>:<len>)\n");
+		return;
+	}
+	printf("Symbol cache @%p: %lu of %lu bytes used\n", theCache, theCache->used, theCache->size);
+	printf("  %8s  %10s  %10s  %s\n", "Size", "Adler32", "MTime", "Key");
+	symCacheWalk(entShow, 0);
+}
+
+/* Discard all entries (except for files in use) */
+void
+symCacheFlush()
+{
+	if ( theCache )
+		symCacheTrim();
+}
@@ -0,0 +1,222 @@
+/* O(1) lookup of names in the built-in symbol table
+ *
+ * When configured with --enable-symtab-hash, symtab-pack.awk
+ * appends a perfect hash over all names of the symbol table
+ * to allsyms.c (see the comments in symtab-pack.awk).
+ *
+ *   gesysSymLookup(name)
+ *
+ * then finds a symbol with one hash computation and a single
+ * string compare (instead of Cexp's binary search) and returns
+ * a pointer to its CexpSymRec (or NULL if 'name' is not in the
+ * built-in table).
+ *
+ * cexpSymLookup() is wrapped (link with -Wl,--wrap,cexpSymLookup; see
+ * configure's --enable-symtab-hash) so that Cexp's loader (resolving
+ * the undefined symbols of a module) and interpreter consult the hash
+ * first. Cexp searches the system module first, hence a name found
+ * in the built-in table is what Cexp would have found; other names
+ * are passed on to Cexp. Setting gesysSymHashBypass routes all
+ * lookups to Cexp. If the symbol usage profile recorder is enabled,
+ * too (symprof.c), the wrapper records system symbols on its behalf.
+ *
+ *   gesysSymLookupBench(loops)
+ *
+ * looks up every name of the table 'loops' times using both
+ * gesysSymLookup() and Cexp's lookup and prints the timings.
+ *
+ *   gesysSymLoadBench(file, loops)
+ *
+ * loads and unloads the module 'file' 'loops' times with and without
+ * the hash and prints the average load time (use a file on a local
+ * file system, e.g., copied to /tmp, so the transfer does not dominate).
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <string.h>
+
+/* generated by symtab-pack.awk */
+extern const unsigned       gesysSymHashSize;
+extern const unsigned       gesysSymHashBuckets;
+extern const unsigned       gesysSymHashMult1;
+extern const unsigned       gesysSymHashMult2;
+extern const unsigned short gesysSymHashDisp[];
+extern const unsigned short gesysSymHashSlot[];
+extern void                *gesysSymHashRec(unsigned i);
+extern const char          *gesysSymHashName(unsigned i);
+
+extern void *__real_cexpSymLookup(const char *name, void **pmod);
+extern void *cexpSystemModule;
+extern void  symProfRecordSym(const char *name) __attribute__((weak));
+extern void *cexpModuleLoad(char *file, char *name);
+extern int   cexpModuleUnload(void *mod);
+
+int gesysSymHashBypass = 0;
+
+#define SYMHASH_UNUSED	0xffff
+
+/* Find 'name' in the built-in symbol table. The three hashes
+ * (bucket, f1, f2) are computed in a single pass; arithmetic is
+ * modulo 2^32 (must match symhash() in symtab-pack.awk).
+ *
+ * RETURNS: pointer to the symbol's CexpSymRec or NULL if not found.
+ */
+void *
+gesysSymLookup(const char *name)
+{
+unsigned long       n, d0, d1, b;
+unsigned            m1 = gesysSymHashMult1, m2 = gesysSymHashMult2;
+unsigned            hb = 0, h1 = 0, h2 = 0, c, i;
+const unsigned char *s;
+
+	if ( 0 == (n = gesysSymHashSize) )
+		return 0;
+
+	for ( s = (const unsigned char*)name; (c = *s); s++ ) {
+		hb = hb * 31 + c;
+		h1 = h1 * m1 + c;
+		h2 = h2 * m2 + c;
+	}
+
+	b  = hb % gesysSymHashBuckets;
+	d0 = gesysSymHashDisp[2*b];
+	d1 = gesysSymHashDisp[2*b + 1];
+
+	/* d0, h2 % n < 65536; reduce the product before adding */
+	i = gesysSymHashSlot[ (h1 % n + (d0 * (h2 % n)) % n + d1) % n ];
+
+	if ( SYMHASH_UNUSED == i || strcmp(gesysSymHashName(i), name) )
+		return 0;
+
+	return gesysSymHashRec(i);
+}
+
+void *
+__wrap_cexpSymLookup(const char *name, void **pmod)
+{
+void *rval, *mod = 0;
+
+	/* the system module is not set up until Cexp initialized */
+	if ( !gesysSymHashBypass && cexpSystemModule && (rval = gesysSymLookup(name)) ) {
+		if ( pmod )
+			*pmod = cexpSystemModule;
+		if ( symProfRecordSym )
+			symProfRecordSym(name);
+		return rval;
+	}
+	if ( (rval = __real_cexpSymLookup(name, &mod)) && cexpSystemModule == mod && symProfRecordSym )
+		symProfRecordSym(name);
+	if ( pmod )
+		*pmod = mod;
+	return rval;
+}
+
+/* Compare gesysSymLookup() against Cexp's lookup.
+ *
+ * RETURNS: number of names for which the two disagree.
+ */
+int
+gesysSymLookupBench(int loops)
+{
+rtems_interval t0, t1, t2, tps;
+unsigned       s, nsyms = 0, bad = 0;
+int            l;
+const char     *nm;
+
+	if ( 0 == gesysSymHashSize ) {
+		fprintf(stderr,"gesysSymLookupBench(): no symbol hash available\n");
+		return -1;
+	}
+	if ( loops < 1 )
+		loops = 1;
+
+	for ( s = 0; s < gesysSymHashSize; s++ ) {
+		if ( SYMHASH_UNUSED == gesysSymHashSlot[s] )
+			continue;
+		nsyms++;
+		nm = gesysSymHashName(gesysSymHashSlot[s]);
+		if ( gesysSymLookup(nm) != gesysSymHashRec(gesysSymHashSlot[s]) ) {
+			fprintf(stderr,"gesysSymLookupBench(): '%s' not found by hash\n", nm);
+			bad++;
+		}
+		if ( !__real_cexpSymLookup(nm, 0) ) {
+			fprintf(stderr,"gesysSymLookupBench(): '%s' not found by Cexp\n", nm);
+			bad++;
+		}
+	}
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+	for ( l = 0; l < loops; l++ ) {
+		for ( s = 0; s < gesysSymHashSize; s++ ) {
+			if ( SYMHASH_UNUSED != gesysSymHashSlot[s] )
+				gesysSymLookup(gesysSymHashName(gesysSymHashSlot[s]));
+		}
+	}
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+	for ( l = 0; l < loops; l++ ) {
+		for ( s = 0; s < gesysSymHashSize; s++ ) {
+			if ( SYMHASH_UNUSED != gesysSymHashSlot[s] )
+				__real_cexpSymLookup(gesysSymHashName(gesysSymHashSlot[s]), 0);
+		}
+	}
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t2 );
+
+	printf("%u symbols x %i lookups: hash %lums, Cexp %lums\n",
+		nsyms, loops,
+		(unsigned long)(t1 - t0) * 1000UL / tps,
+		(unsigned long)(t2 - t1) * 1000UL / tps);
+
+	return bad;
+}
+
+/* Time loading 'file' with and without the hash.
+ *
+ * RETURNS: 0 on success, -1 if the module could not be loaded.
+ */
+int
+gesysSymLoadBench(char *file, int loops)
+{
+rtems_interval t0, t1, tps, tot[2];
+void           *m;
+int            l, bypass, saved = gesysSymHashBypass;
+
+	if ( !file ) {
+		fprintf(stderr,"usage: gesysSymLoadBench(\"file\", loops)\n");
+		return -1;
+	}
+	if ( loops < 1 )
+		loops = 1;
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	for ( bypass = 0; bypass < 2; bypass++ ) {
+		gesysSymHashBypass = bypass;
+		tot[bypass] = 0;
+		for ( l = 0; l < loops; l++ ) {
+			rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+			m = cexpModuleLoad(file, 0);
+			rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+			if ( !m ) {
+				fprintf(stderr,"gesysSymLoadBench(): unable to load '%s'\n", file);
+				gesysSymHashBypass = saved;
+				return -1;
+			}
+			tot[bypass] += t1 - t0;
+			cexpModuleUnload(m);
+		}
+	}
+	gesysSymHashBypass = saved;
+
+	printf("'%s' x %i loads: hash %lums, Cexp %lums per load\n",
+		file, loops,
+		(unsigned long)tot[0] * 1000UL / tps / loops,
+		(unsigned long)tot[1] * 1000UL / tps / loops);
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/* Record which modules are loaded at run-time (symbol usage profile)
+ *
+ * GeSys links as much as it can from all libraries ('OPTIONAL_ALL'
+ * in the Makefile) so that any module may be loaded. In production
+ * only a fraction of this is ever used by the modules that are
+ * actually loaded.
+ *
+ * This module wraps cexpModuleLoad() (link with
+ * -Wl,--wrap,cexpModuleLoad; see configure's --enable-symprof).
+ * Since allsyms.c is linked with the same flags the Cexp shell's
+ * 'ld' (and any module calling cexpModuleLoad) goes through the
+ * wrapper, too. The file name of every module which was loaded
+ * successfully is recorded.
+ *
+ * Scripts and the shell also call system functions directly, i.e.,
+ * without any module referencing them. cexpSymLookup() is wrapped,
+ * too (-Wl,--wrap,cexpSymLookup) and every name which is found in
+ * the system module (the built-in symbol table) is recorded.
+ *
+ *   symProfDump("/tmp/modules.prof")
+ *
+ * writes the lists (one module file per line followed by one line
+ * '@<symbol>' per symbol; to stdout if the path is NULL). Collect
+ * the lists from the systems in the field and feed them to the
+ * 'symprof' script (Makefile variable SYMPROF) which looks at the
+ * undefined symbols of these modules (i.e., what they bind to) plus
+ * the recorded symbols and generates include/exclude lists for
+ * 'ldep' so that only the library objects which are needed are linked.
+ *
+ * If module prefetching is enabled (prefetch.c) that module owns the
+ * cexpModuleLoad() wrapper and calls symProfRecord(). Likewise, the
+ * symbol hash (symhash.c) owns the cexpSymLookup() wrapper and calls
+ * symProfRecordSym().
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern void *__real_cexpModuleLoad(char *file, char *name);
+extern void *__real_cexpSymLookup(const char *name, void **pmod);
+extern void *cexpSystemModule;
+
+#ifndef SYMPROF_SYM_BUCKETS
+#define SYMPROF_SYM_BUCKETS	256		/* power of two */
+#endif
+
+typedef struct SymProfModRec_ {
+	struct SymProfModRec_	*next;
+	unsigned long			loads;
+	char					file[];
+} SymProfModRec, *SymProfMod;
+
+static SymProfMod symProfMods = 0;
+
+typedef struct SymProfSymRec_ {
+	struct SymProfSymRec_	*next;
+	unsigned long			lookups;
+	char					name[];
+} SymProfSymRec, *SymProfSym;
+
+static SymProfSym symProfSyms[SYMPROF_SYM_BUCKETS] = { 0 };
+
+void
+symProfRecord(const char *file)
+{
+SymProfMod            m;
+rtems_interrupt_level l;
+
+	/* list is only ever prepended to; no lock for searching */
+	for ( m = symProfMods; m; m = m->next ) {
+		if ( 0 == strcmp(m->file, file) ) {
+			m->loads++;
+			return;
+		}
+	}
+
+	if ( !(m = malloc(sizeof(*m) + strlen(file) + 1)) )
+		return;
+	strcpy(m->file, file);
+	m->loads = 1;
+
+	rtems_interrupt_disable(l);
+	m->next     = symProfMods;
+	symProfMods = m;
+	rtems_interrupt_enable(l);
+}
+
+/* Record a name which was found in the system module */
+void
+symProfRecordSym(const char *name)
+{
+SymProfSym            m, *pb;
+unsigned              h = 0;
+const unsigned char   *p;
+rtems_interrupt_level l;
+
+	for ( p = (const unsigned char*)name; *p; p++ )
+		h = h * 31 + *p;
+	pb = &symProfSyms[h & (SYMPROF_SYM_BUCKETS - 1)];
+
+	/* buckets are only ever prepended to; no lock for searching */
+	for ( m = *pb; m; m = m->next ) {
+		if ( 0 == strcmp(m->name, name) ) {
+			m->lookups++;
+			return;
+		}
+	}
+
+	if ( !(m = malloc(sizeof(*m) + strlen(name) + 1)) )
+		return;
+	strcpy(m->name, name);
+	m->lookups = 1;
+
+	rtems_interrupt_disable(l);
+	m->next = *pb;
+	*pb     = m;
+	rtems_interrupt_enable(l);
+}
+
+#ifndef MODULE_PREFETCH
+void *
+__wrap_cexpModuleLoad(char *file, char *name)
+{
+void *rval;
+
+	if ( (rval = __real_cexpModuleLoad(file, name)) && file )
+		symProfRecord(file);
+	return rval;
+}
+#endif
+
+#ifndef SYMTAB_HASH
+void *
+__wrap_cexpSymLookup(const char *name, void **pmod)
+{
+void *rval, *mod = 0;
+
+	if ( (rval = __real_cexpSymLookup(name, &mod)) && cexpSystemModule == mod )
+		symProfRecordSym(name);
+	if ( pmod )
+		*pmod = mod;
+	return rval;
+}
+#endif
+
+/* Write the list of loaded modules and of the system symbols
+ * looked up to 'path' (stdout if NULL)
+ *
+ * RETURNS: number of modules listed or -1 on error.
+ */
+int
+symProfDump(const char *path)
+{
+FILE       *f = stdout;
+SymProfMod m;
+SymProfSym s;
+int        n  = 0, b;
+
+	if ( path && !(f = fopen(path, "w")) ) {
+		perror("symProfDump(): unable to open file");
+		return -1;
+	}
+
+	fprintf(f, "# modules loaded (file, number of loads)\n");
+	for ( m = symProfMods; m; m = m->next, n++ )
+		fprintf(f, "%s %lu\n", m->file, m->loads);
+
+	fprintf(f, "# system symbols looked up (@name, number of lookups)\n");
+	for ( b = 0; b < SYMPROF_SYM_BUCKETS; b++ ) {
+		for ( s = symProfSyms[b]; s; s = s->next )
+			fprintf(f, "@%s %lu\n", s->name, s->lookups);
+	}
+
+	if ( f != stdout )
+		fclose(f);
+	return n;
+}
@@ -0,0 +1,368 @@
+# Post-process the symbol table generated by 'ldep -C' (allsyms.c)
+#
+#   awk -f symtab-pack.awk [-v pool=0|1] [-v phash=0|1] allsyms.c > allsyms-packed.c
+#
+# pool  (default 1): move the names into a string pool (see below)
+# phash (default 0): append a perfect hash over the names
+#                    (used by gesysSymLookup(), see symhash.c)
+#
+# ldep emits a separate string literal for the name of every
+# symbol record. This script moves all names into one string pool
+# where
+#   - duplicate names are stored once;
+#   - a name which is the tail of another one shares its storage
+#     (e.g., "free" lives inside "_free").
+# The name in each record is replaced by a pointer into the pool.
+# Since Cexp references the names as plain C strings, the pool
+# cannot be prefix-compressed and the record layout (defined by
+# Cexp) is left alone.
+#
+# The table is recognized as the (first) initialized array of
+# CexpSymRec; the first string literal in each record is taken to
+# be the symbol name. If no such table is found the input is
+# copied unchanged (and a warning printed).
+#
+# The perfect hash uses the 'hash and displace' scheme: keys are
+# distributed into buckets by h(name, 31); for each bucket (largest
+# first) a displacement (d0, d1) is searched such that all its keys
+# land in free slots at
+#     (h(name, mult1) + d0 * h(name, mult2) + d1) mod size
+# where 'size' is the smallest prime >= the number of names (a prime
+# guarantees that d0 can separate any two keys unless they collide
+# in both hashes). Unused slots hold 0xffff.
+# h() must match gesysSymLookup() in symhash.c.
+#
+# Statistics are printed to stderr.
+
+# polynomial hash with multiplier m modulo 2^32, i.e., the C code
+# may use plain 32-bit unsigned arithmetic (m < 64 keeps the
+# intermediate result exact in awk's double precision)
+function symhash(s, m,    h, i)
+{
+	h = 0
+	for ( i = 1; i <= length(s); i++ )
+		h = (h * m + ord[substr(s, i, 1)]) % 4294967296
+	return h
+}
+
+function isprime(n,    d)
+{
+	if ( n < 2 )
+		return 0
+	for ( d = 2; d * d <= n; d++ )
+		if ( 0 == n % d )
+			return 0
+	return 1
+}
+
+# RETURNS: 0 on success, -1 if no hash could be found
+function mkphash(    i, j, k, b, nb, bsz, bkey, border, d0, d1, ok, p, taken, f1, f2, mem, nm, try)
+{
+	for ( i = 1; i < 256; i++ )
+		ord[sprintf("%c", i)] = i
+
+	nb     = int((nsyms + 3) / 4)
+	for ( hsize = nsyms; !isprime(hsize); hsize++ )
+		;
+	for ( b = 0; b < nb; b++ )
+		bsz[b] = 0
+
+	nm = 0
+	for ( i = 1; i <= nsyms; i++ ) {
+		if ( dup[i] )
+			continue
+		nm++
+		b = symhash(name[i], 31) % nb
+		mem[b, bsz[b]++] = i
+	}
+	if ( nm != nsyms ) {
+		print "symtab-pack.awk: duplicate symbol names; no perfect hash generated" > "/dev/stderr"
+		return -1
+	}
+
+	for ( b = 0; b < nb; b++ ) {
+		bkey[b + 1]   = bsz[b]
+		border[b + 1] = b
+	}
+	hsort(bkey, border, nb)
+
+	# two keys of a bucket may collide in both f1 and f2 (or the
+	# table may be too full); start over with other multipliers
+	for ( try = 0; try < 8; try++ ) {
+		mult1 = 33 + 4 * try
+		mult2 = 35 + 4 * try
+		for ( i = 1; i <= nsyms; i++ ) {
+			f1[i] = symhash(name[i], mult1) % hsize
+			f2[i] = symhash(name[i], mult2) % hsize
+		}
+
+		for ( i = 0; i < hsize; i++ )
+			slot[i] = -1
+
+		for ( j = 1; j <= nb; j++ ) {
+			b  = border[j]
+			ok = 0
+			for ( d0 = 0; d0 < hsize && !ok; d0++ ) {
+				for ( d1 = 0; d1 < hsize && !ok; d1++ ) {
+					ok = 1
+					for ( k = 0; k < bsz[b]; k++ ) {
+						p = (f1[mem[b, k]] + d0 * f2[mem[b, k]] + d1) % hsize
+						if ( slot[p] >= 0 || (p in taken) ) {
+							ok = 0
+							break
+						}
+						taken[p] = 1
+					}
+					delete taken
+				}
+			}
+			if ( !ok )
+				break
+			d0--; d1--
+			disp0[b] = d0
+			disp1[b] = d1
+			for ( k = 0; k < bsz[b]; k++ ) {
+				p = (f1[mem[b, k]] + d0 * f2[mem[b, k]] + d1) % hsize
+				slot[p] = mem[b, k] - 1
+			}
+		}
+		if ( ok ) {
+			nbuckets = nb
+			return 0
+		}
+	}
+	print "symtab-pack.awk: unable to find perfect hash" > "/dev/stderr"
+	return -1
+}
+
+function rev(s,    r, i)
+{
+	r = ""
+	for ( i = length(s); i > 0; i-- )
+		r = r substr(s, i, 1)
+	return r
+}
+
+# sort keys k[1..n] (descending) carrying index array x along;
+# heapsort (awk implementations limit recursion depth)
+function hsort(k, x, n,    i, end)
+{
+	for ( i = int(n / 2); i >= 1; i-- )
+		sift(k, x, i, n)
+	for ( end = n; end > 1; end-- ) {
+		swap(k, x, 1, end)
+		sift(k, x, 1, end - 1)
+	}
+}
+
+# min-heap (yields descending order)
+function sift(k, x, i, n,    c)
+{
+	while ( (c = 2 * i) <= n ) {
+		if ( c < n && k[c + 1] < k[c] )
+			c++
+		if ( !(k[c] < k[i]) )
+			break
+		swap(k, x, i, c)
+		i = c
+	}
+}
+
+function swap(k, x, i, j,    t)
+{
+	t = k[i]; k[i] = k[j]; k[j] = t
+	t = x[i]; x[i] = x[j]; x[j] = t
+}
+
+{
+	line[NR] = $0
+}
+
+END {
+	if ( "" == pool )
+		pool = 1
+	if ( "" == phash )
+		phash = 0
+
+	nlines = NR
+	tab    = 0
+	nsyms  = 0
+	depth  = 0
+
+	for ( l = 1; l <= nlines; l++ ) {
+		s = line[l]
+		if ( !tab ) {
+			if ( s ~ /CexpSymRec/ && s ~ /\[[ \t]*\]/ && s ~ /=/ ) {
+				tab   = l
+				depth = 0
+			} else {
+				continue
+			}
+		}
+		# scan characters to track nesting and find literals
+		for ( i = 1; i <= length(s); i++ ) {
+			c = substr(s, i, 1)
+			if ( "\"" == c ) {
+				if ( match(substr(s, i), /^"([^"\\]|\\.)*"/) ) {
+					if ( depth >= 2 && !named ) {
+						nsyms++
+						name[nsyms]    = substr(s, i + 1, RLENGTH - 2)
+						symline[nsyms] = l
+						symcol[nsyms]  = i
+						symlen[nsyms]  = RLENGTH
+						named = 1
+					}
+					i += RLENGTH - 1
+				}
+				continue
+			}
+			if ( "{" == c ) {
+				# new record
+				if ( 2 == ++depth )
+					named = 0
+			} else if ( "}" == c ) {
+				if ( 0 == --depth ) {
+					tabend = l
+					l = nlines + 1
+					break
+				}
+			}
+		}
+	}
+
+	if ( !tab || !nsyms ) {
+		print "symtab-pack.awk: no CexpSymRec table found; output unchanged" > "/dev/stderr"
+		for ( l = 1; l <= nlines; l++ )
+			print line[l]
+		if ( phash ) {
+			# keep symhash.c linkable
+			print  ""
+			print  "const unsigned gesysSymHashSize = 0, gesysSymHashBuckets = 0;"
+			print  "const unsigned gesysSymHashMult1 = 0, gesysSymHashMult2 = 0;"
+			print  "const unsigned short gesysSymHashDisp[] = { 0, 0 };"
+			print  "const unsigned short gesysSymHashSlot[] = { 65535 };"
+			print  "void *gesysSymHashRec(unsigned i) { return 0; }"
+			print  "const char *gesysSymHashName(unsigned i) { return \"\"; }"
+		}
+		exit 0
+	}
+
+	# build the pool: sort reversed names descending so a tail of
+	# a name immediately follows it (or another name with the same tail)
+	for ( i = 1; i <= nsyms; i++ ) {
+		key[i] = rev(name[i])
+		idx[i] = i
+	}
+	hsort(key, idx, nsyms)
+
+	poolsz = 0
+	npool  = 0
+	oldsz  = 0
+	for ( i = 1; i <= nsyms; i++ ) {
+		j      = idx[i]
+		oldsz += length(name[j]) + 1
+		if ( i > 1 && index(key[i-1], key[i]) == 1 ) {
+			# tail of the previous name (or a duplicate)
+			p      = idx[i-1]
+			off[j] = off[p] + length(name[p]) - length(name[j])
+			if ( key[i-1] == key[i] )
+				dup[j] = 1
+		} else {
+			off[j]        = poolsz
+			strs[++npool] = name[j]
+			poolsz       += length(name[j]) + 1
+		}
+	}
+
+	for ( l = 1; l < tab; l++ )
+		print line[l]
+
+	if ( pool ) {
+		printf "/* %d symbol names; string pool generated by symtab-pack.awk */\n", nsyms
+		print  "static const char gesysSymPool[] ="
+		for ( i = 1; i <= npool; i++ )
+			printf "\t\"%s\\0\"\n", strs[i]
+		print  ";"
+		print  ""
+	}
+
+	# substitute the names (a line may hold several records)
+	k = 1
+	for ( l = tab; l <= nlines; l++ ) {
+		s = line[l]
+		if ( pool && k <= nsyms && symline[k] == l ) {
+			out = ""
+			pos = 1
+			while ( k <= nsyms && symline[k] == l ) {
+				out = out substr(s, pos, symcol[k] - pos) sprintf("(gesysSymPool+%d)", off[k])
+				pos = symcol[k] + symlen[k]
+				k++
+			}
+			s = out substr(s, pos)
+		}
+		print s
+	}
+
+	if ( pool )
+		printf "symtab-pack.awk: %d names, %d bytes of strings -> %d bytes pool\n", nsyms, oldsz, poolsz > "/dev/stderr"
+
+	if ( !phash )
+		exit 0
+
+	s = line[tab]
+	match(s, /[A-Za-z_][A-Za-z_0-9]*[ \t]*\[[ \t]*\]/)
+	tabname = substr(s, RSTART, RLENGTH)
+	sub(/[ \t]*\[.*/, "", tabname)
+
+	# on failure emit an empty hash (gesysSymLookup() then
+	# always fails and the caller falls back to Cexp)
+	if ( nsyms >= 65000 ) {
+		print "symtab-pack.awk: too many symbols for perfect hash" > "/dev/stderr"
+		hsize = 0
+	} else if ( mkphash() ) {
+		hsize = 0
+	}
+	if ( 0 == hsize ) {
+		nbuckets = 0
+		mult1    = 0
+		mult2    = 0
+	}
+
+	print  ""
+	printf "/* perfect hash over the %d names of %s[] (symtab-pack.awk) */\n", nsyms, tabname
+	printf "const unsigned gesysSymHashSize    = %d;\n", hsize
+	printf "const unsigned gesysSymHashBuckets = %d;\n", nbuckets
+	printf "const unsigned gesysSymHashMult1   = %d;\n", mult1
+	printf "const unsigned gesysSymHashMult2   = %d;\n", mult2
+	print  ""
+	print  "/* displacements (d0, d1) per bucket */"
+	print  "const unsigned short gesysSymHashDisp[] = {"
+	for ( b = 0; b < nbuckets; b++ )
+		printf "\t%d, %d,\n", disp0[b], disp1[b]
+	if ( 0 == nbuckets )
+		print  "\t0, 0"
+	print  "};"
+	print  ""
+	print  "/* slot -> index into the table (0xffff: unused) */"
+	print  "const unsigned short gesysSymHashSlot[] = {"
+	for ( i = 0; i < hsize; i++ )
+		printf "\t%d,\n", slot[i] < 0 ? 65535 : slot[i]
+	if ( 0 == hsize )
+		print  "\t65535"
+	print  "};"
+	print  ""
+	print  "void *"
+	print  "gesysSymHashRec(unsigned i)"
+	print  "{"
+	printf "\treturn (void*)&%s[i];\n", tabname
+	print  "}"
+	print  ""
+	print  "const char *"
+	print  "gesysSymHashName(unsigned i)"
+	print  "{"
+	printf "\treturn %s[i].name;\n", tabname
+	print  "}"
+
+	if ( hsize )
+		printf "symtab-pack.awk: perfect hash with %d buckets, %d slots generated\n", nbuckets, hsize > "/dev/stderr"
+}
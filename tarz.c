@@ -0,0 +1,389 @@
+/* Load a (possibly compressed) tar image into the filesystem
+ *
+ * gesysTarfsLoad() checks the magic number of the image:
+ *
+ *  - gzip (1f 8b): the image is inflated in a stream and the
+ *    archive members are written straight into the filesystem
+ *    (needs zlib; HAVE_ZLIB). No buffer for the uncompressed
+ *    image is needed. ustar archives are understood plus GNU
+ *    long names ('L' and 'K' members, as written by GNU tar for
+ *    names exceeding 100 chars); other member types are skipped.
+ *  - anything else is passed to rtems_tarfs_load() which
+ *    creates files referencing the image in place.
+ *
+ * Load statistics are printed.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rtems.h>
+#include <rtems/libio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define TAR_BLK		512
+
+/* ustar header fields */
+#define TAR_NAME	0
+#define TAR_MODE	100
+#define TAR_SIZE	124
+#define TAR_CHKSUM	148
+#define TAR_TYPE	156
+#define TAR_LINK	157
+#define TAR_MAGIC	257
+#define TAR_PREFIX	345
+
+#define LF_OLDNORMAL  '\0'
+#define LF_NORMAL     '0'
+#define LF_SYMLINK    '2'
+#define LF_DIR        '5'
+#define LF_LONGLINK   'K'	/* GNU: data is the next member's link name */
+#define LF_LONGNAME   'L'	/* GNU: data is the next member's name      */
+
+/* sanity limit for GNU long names */
+#ifndef TARZ_MAX_LONGNAME
+#define TARZ_MAX_LONGNAME	4096
+#endif
+
+typedef struct TarStreamRec_ {
+	const char		*mntpt;
+	char			hdr[TAR_BLK];
+	unsigned		hdrFill;
+	unsigned long	remaining;	/* file data left in current member */
+	unsigned long	skip;		/* padding to skip                  */
+	int				fd;
+	char			*collect;	/* current member's data goes here  */
+	char			*longName;	/* GNU long name for the next member */
+	char			*longLink;	/* GNU long link for the next member */
+	int				done;		/* end-of-archive seen              */
+	unsigned long	nFiles, nDirs, nBytes, nSkipped;
+} TarStreamRec, *TarStream;
+
+static unsigned long
+o2ul(const char *chpt, int len)
+{
+unsigned long rval;
+	for (rval = 0; --len >= 0 && *chpt; chpt++) {
+		if ( *chpt < '0' || *chpt > '7' )
+			continue;
+		rval = 8*rval + (*chpt-'0');
+	}
+	return rval;
+}
+
+static int
+tarChksumOk(const char *hdr)
+{
+const unsigned char *p = (const unsigned char*)hdr;
+unsigned long sum = 0;
+int           i;
+	for ( i = 0; i < TAR_BLK; i++ )
+		sum += (i >= TAR_CHKSUM && i < TAR_CHKSUM + 8) ? ' ' : p[i];
+	return sum == o2ul(hdr + TAR_CHKSUM, 8);
+}
+
+/* Close the current member's file (if any) */
+static void
+tarClose(TarStream ts)
+{
+	if ( ts->fd >= 0 ) {
+		close(ts->fd);
+		ts->fd = -1;
+	}
+}
+
+/* GNU long name/link member; its data is collected into a
+ * buffer which replaces the name/link field of the next header.
+ *
+ * RETURNS: 0 on success, -1 on error.
+ */
+static int
+tarLongName(TarStream ts, char **pbuf, unsigned long size)
+{
+	if ( size < 1 || size > TARZ_MAX_LONGNAME ) {
+		fprintf(stderr,"gesysTarfsLoad: GNU long name of %lu chars not supported\n", size);
+		return -1;
+	}
+	free(*pbuf);
+	if ( !(*pbuf = calloc(1, size + 1)) ) {
+		fprintf(stderr,"gesysTarfsLoad: no memory\n");
+		return -1;
+	}
+	tarClose(ts);
+	ts->collect   = *pbuf;
+	ts->remaining = size;
+	return 0;
+}
+
+/* Process a complete header; RETURNS 0 on success, -1 on error */
+static int
+tarHeader(TarStream ts)
+{
+char          *h = ts->hdr;
+char          *path = 0;
+char          *link = 0;
+unsigned long size;
+int           i, rval = -1;
+
+	/* all-zero block marks the end of the archive */
+	for ( i = 0; i < TAR_BLK && !h[i]; i++ )
+		;
+	if ( TAR_BLK == i ) {
+		ts->done = 1;
+		return 0;
+	}
+
+	if ( strncmp(h + TAR_MAGIC, "ustar", 5) ) {
+		fprintf(stderr,"gesysTarfsLoad: not a ustar archive\n");
+		return -1;
+	}
+	if ( !tarChksumOk(h) ) {
+		fprintf(stderr,"gesysTarfsLoad: header checksum mismatch\n");
+		return -1;
+	}
+
+	size = o2ul(h + TAR_SIZE, 12);
+	ts->skip = (TAR_BLK - (size % TAR_BLK)) % TAR_BLK;
+
+	switch ( h[TAR_TYPE] ) {
+		case LF_LONGNAME:
+			return tarLongName(ts, &ts->longName, size);
+		case LF_LONGLINK:
+			return tarLongName(ts, &ts->longLink, size);
+		default:
+			break;
+	}
+
+	/* a GNU long name/link applies to this member only */
+	if ( ts->longName ) {
+		path = malloc(strlen(ts->mntpt) + strlen(ts->longName) + 2);
+	} else {
+		path = malloc(strlen(ts->mntpt) + 155 + 100 + 3);
+	}
+	if ( !path ) {
+		fprintf(stderr,"gesysTarfsLoad: no memory\n");
+		goto bail;
+	}
+	strcpy(path, ts->mntpt);
+	strcat(path, "/");
+	if ( ts->longName ) {
+		strcat(path, ts->longName);
+	} else {
+		if ( h[TAR_PREFIX] ) {
+			strncat(path, h + TAR_PREFIX, 155);
+			strcat(path, "/");
+		}
+		strncat(path, h + TAR_NAME, 100);
+	}
+
+	if ( ts->longLink ) {
+		link         = ts->longLink;
+		ts->longLink = 0;
+	} else if ( (link = malloc(101)) ) {
+		strncpy(link, h + TAR_LINK, 100);
+		link[100] = 0;
+	} else {
+		fprintf(stderr,"gesysTarfsLoad: no memory\n");
+		goto bail;
+	}
+
+	switch ( h[TAR_TYPE] ) {
+		case LF_OLDNORMAL:
+		case LF_NORMAL:
+			tarClose(ts);
+			if ( (ts->fd = creat(path, o2ul(h + TAR_MODE, 8) & 0777)) < 0 ) {
+				fprintf(stderr,"gesysTarfsLoad: creating '%s': %s\n", path, strerror(errno));
+				goto bail;
+			}
+			ts->nFiles++;
+			ts->remaining = size;
+			/* tarStream() closes it once the data is written */
+			if ( 0 == size )
+				tarClose(ts);
+			break;
+
+		case LF_DIR:
+			/* strip trailing slash */
+			if ( (i = strlen(path)) > 1 && '/' == path[i-1] )
+				path[i-1] = 0;
+			if ( mkdir(path, 0777) && EEXIST != errno ) {
+				fprintf(stderr,"gesysTarfsLoad: mkdir '%s': %s\n", path, strerror(errno));
+				goto bail;
+			}
+			ts->nDirs++;
+			break;
+
+		case LF_SYMLINK:
+			if ( symlink(link, path) ) {
+				fprintf(stderr,"gesysTarfsLoad: symlink '%s': %s\n", path, strerror(errno));
+			}
+			break;
+
+		default:
+			/* unsupported type; skip data */
+			ts->nSkipped++;
+			tarClose(ts);
+			ts->remaining = size;
+			break;
+	}
+	rval = 0;
+
+bail:
+	free(ts->longName);
+	ts->longName = 0;
+	free(path);
+	free(link);
+	return rval;
+}
+
+/* Feed 'len' bytes of the archive; RETURNS 0 on success, -1 on error */
+static int
+tarStream(TarStream ts, const char *buf, unsigned long len)
+{
+unsigned long n;
+int           put;
+
+	while ( len > 0 && !ts->done ) {
+		if ( ts->remaining ) {
+			n = ts->remaining < len ? ts->remaining : len;
+			if ( ts->collect ) {
+				memcpy(ts->collect, buf, n);
+				ts->collect += n;
+			} else if ( ts->fd >= 0 ) {
+				if ( (put = write(ts->fd, buf, n)) <= 0 ) {
+					fprintf(stderr,"gesysTarfsLoad: write: %s\n", strerror(errno));
+					return -1;
+				}
+				n = put;
+				ts->nBytes += n;
+			}
+			ts->remaining -= n;
+			if ( 0 == ts->remaining ) {
+				ts->collect = 0;
+				tarClose(ts);
+			}
+		} else if ( ts->skip ) {
+			n = ts->skip < len ? ts->skip : len;
+			ts->skip -= n;
+		} else {
+			n = TAR_BLK - ts->hdrFill;
+			if ( n > len )
+				n = len;
+			memcpy(ts->hdr + ts->hdrFill, buf, n);
+			if ( TAR_BLK == (ts->hdrFill += n) ) {
+				ts->hdrFill = 0;
+				if ( tarHeader(ts) )
+					return -1;
+			}
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+#ifdef HAVE_ZLIB
+#define TARZ_CHUNK	(32*1024)
+
+static int
+tarzInflate(TarStream ts, void *img, unsigned long len, unsigned long *pOut)
+{
+z_stream  zs;
+char      *out;
+int       st, rval = -1;
+
+	if ( !(out = malloc(TARZ_CHUNK)) ) {
+		fprintf(stderr,"gesysTarfsLoad: no memory\n");
+		return -1;
+	}
+
+	memset(&zs, 0, sizeof(zs));
+	zs.next_in  = img;
+	zs.avail_in = len;
+
+	/* 16 + MAX_WBITS: expect gzip header */
+	if ( Z_OK != inflateInit2(&zs, 16 + MAX_WBITS) ) {
+		fprintf(stderr,"gesysTarfsLoad: inflateInit2 failed\n");
+		free(out);
+		return -1;
+	}
+
+	do {
+		zs.next_out  = (Bytef*)out;
+		zs.avail_out = TARZ_CHUNK;
+		st = inflate(&zs, Z_NO_FLUSH);
+		if ( Z_OK != st && Z_STREAM_END != st ) {
+			fprintf(stderr,"gesysTarfsLoad: inflate failed: %s\n", zs.msg ? zs.msg : "?");
+			goto bail;
+		}
+		if ( tarStream(ts, out, TARZ_CHUNK - zs.avail_out) )
+			goto bail;
+	} while ( Z_STREAM_END != st && !ts->done );
+
+	rval = 0;
+
+bail:
+	*pOut = zs.total_out;
+	inflateEnd(&zs);
+	free(out);
+	return rval;
+}
+#endif
+
+/* Load the tar image at 'img' ('len' bytes) into directory 'mntpt'
+ * (which must exist).
+ *
+ * RETURNS: 0 on success, nonzero on error.
+ */
+int
+gesysTarfsLoad(const char *mntpt, void *img, unsigned long len)
+{
+unsigned char  *m = img;
+TarStreamRec   ts;
+unsigned long  out = 0;
+int            st;
+rtems_interval t0, t1, tps;
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t0 );
+
+	if ( len < 2 || 0x1f != m[0] || 0x8b != m[1] ) {
+		/* plain archive; files reference the image in place */
+		return rtems_tarfs_load((char*)mntpt, img, len);
+	}
+
+	memset(&ts, 0, sizeof(ts));
+	ts.mntpt = mntpt;
+	ts.fd    = -1;
+
+#ifdef HAVE_ZLIB
+	st = tarzInflate(&ts, img, len, &out);
+#else
+	fprintf(stderr,"gesysTarfsLoad: compressed image but no zlib support compiled in\n");
+	st = -1;
+#endif
+
+	tarClose(&ts);
+	free(ts.longName);
+	free(ts.longLink);
+
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &t1 );
+	rtems_clock_get( RTEMS_CLOCK_GET_TICKS_PER_SECOND, &tps );
+
+	printf("TARFS: %lu -> %lu bytes (%lu files, %lu dirs, %lu bytes of data",
+		len, out, ts.nFiles, ts.nDirs, ts.nBytes);
+	if ( ts.nSkipped )
+		printf(", %lu unsupported members skipped", ts.nSkipped);
+	printf(") in %lums\n", (unsigned long)(t1 - t0) * 1000UL / tps);
+
+	return st;
+}